@@ -0,0 +1,185 @@
+/**
+ * @file libtsp.cpp
+ * @brief C interface (tsp.h) over the header-only solver
+ *
+ * Every entry point catches all exceptions and turns them into TSP_ERROR plus a
+ * per-thread message, so the library can be loaded from C, Python (ctypes) or
+ * any other FFI.
+ */
+#include "tsp.h"
+#include "tsp_solver.hpp"
+
+/**
+ * @brief Opaque instance handle: the shared, immutable problem data
+ *
+ * The matrix is borrowed from the caller whatever its dtype; float32 / int32
+ * entries are converted to double as the kernels read them.
+ */
+struct tsp_instance {
+    std::shared_ptr<const Instance> instance; ///< Problem data shared by every solve
+};
+
+namespace {
+
+thread_local std::string lastError; ///< Message behind tsp_last_error()
+
+/**
+ * @brief Records the message of a failed call and returns TSP_ERROR
+ */
+tsp_status fail(const char* message) {
+    lastError = message;
+    return TSP_ERROR;
+}
+
+/**
+ * @brief Translates C options into the solver's SearchOptions
+ * @throws std::runtime_error on an unknown operator or engine name
+ */
+SearchOptions toSearchOptions(const tsp_options& options) {
+    SearchOptions search;
+    if (options.vnd) {
+        search.chain.clear();
+        for (const std::string& op : splitList(options.vnd)) {
+            search.chain.push_back(parseOperatorName(op));
+        }
+        if (search.chain.empty()) throw std::runtime_error("vnd needs at least one operator");
+    }
+    if (options.engine) search.engine = parseEngineName(options.engine);
+    if (options.threads < 0) throw std::runtime_error("threads must not be negative");
+    search.threads = options.threads;
+    if (options.neighbors > 0) search.neighborListSize = options.neighbors;
+    search.quantize = options.quantize != 0;
+
+    if (options.progress) {
+        tsp_progress_fn progress = options.progress;
+        void* user = options.user_data;
+        search.progress = [progress, user](const SearchProgress& state) {
+            progress(user, state.restartsDone, state.restartsTotal, state.best);
+        };
+    }
+    if (options.cancel) {
+        tsp_cancel_fn cancel = options.cancel;
+        void* user = options.user_data;
+        search.cancel = [cancel, user]() { return cancel(user) != 0; };
+    }
+    return search;
+}
+
+/**
+ * @brief Shared body of tsp_solve and tsp_solve_subset
+ * @param cities Subset to visit, or nullptr for every city
+ */
+tsp_status solve(const tsp_instance* instance, const tsp_options* options,
+                 const int* cities, size_t count, int* tour, double* length) {
+    if (!instance || !tour) return fail("instance and tour must not be NULL");
+    if (cities && count == 0) return fail("cities must not be empty");
+    try {
+        tsp_options defaults;
+        tsp_options_init(&defaults);
+        const tsp_options& opts = options ? *options : defaults;
+        if (opts.iterations < 0 || opts.restarts < 1) {
+            return fail("iterations must not be negative and restarts must be at least 1");
+        }
+
+        TSPSolver solver(instance->instance, opts.seed);
+        solver.configureSearch(toSearchOptions(opts));
+        std::vector<int> best;
+        if (cities) {
+            best = solver.solveSubset(std::vector<int>(cities, cities + count),
+                                      opts.iterations, opts.restarts, false);
+        } else {
+            best = solver.solveTSP(opts.iterations, opts.restarts);
+        }
+        std::copy(best.begin(), best.end(), tour);
+        if (length) *length = solver.calculateTourLength(best);
+        lastError.clear();
+        return solver.cancelled() ? TSP_CANCELLED : TSP_OK;
+    } catch (const std::exception& e) {
+        return fail(e.what());
+    } catch (...) {
+        return fail("Unknown error");
+    }
+}
+
+} // namespace
+
+extern "C" {
+
+TSP_API void tsp_options_init(tsp_options* options) {
+    if (!options) return;
+    *options = tsp_options{};
+    options->iterations = 1000;
+    options->restarts = 10;
+    options->seed = 42;
+    options->neighbors = SearchOptions{}.neighborListSize;
+}
+
+TSP_API tsp_instance* tsp_instance_create(const void* data, size_t n,
+                                          size_t row_stride_bytes, tsp_dtype dtype) {
+    try {
+        size_t element = dtype == TSP_FLOAT64 ? sizeof(double)
+                       : dtype == TSP_FLOAT32 ? sizeof(float)
+                       : dtype == TSP_INT32   ? sizeof(int32_t) : 0;
+        if (element == 0) {
+            fail("Unknown dtype");
+            return nullptr;
+        }
+        if (!data || n == 0) {
+            fail("Matrix must not be empty");
+            return nullptr;
+        }
+        if (row_stride_bytes == 0) row_stride_bytes = n * element;
+        if (row_stride_bytes % element != 0 || row_stride_bytes < n * element) {
+            fail("Row stride must be a multiple of the element size and cover a row");
+            return nullptr;
+        }
+        size_t rowStride = row_stride_bytes / element;
+
+        DistanceMatrix matrix;
+        switch (dtype) {
+            case TSP_FLOAT64:
+                matrix = DistanceMatrix::borrow(static_cast<const double*>(data), n, rowStride);
+                break;
+            case TSP_FLOAT32:
+                matrix = DistanceMatrix::borrow(static_cast<const float*>(data), n, rowStride);
+                break;
+            default:
+                matrix = DistanceMatrix::borrow(static_cast<const int32_t*>(data), n, rowStride);
+                break;
+        }
+        auto handle = std::make_unique<tsp_instance>();
+        handle->instance = std::make_shared<const Instance>(std::move(matrix));
+        lastError.clear();
+        return handle.release();
+    } catch (const std::exception& e) {
+        fail(e.what());
+    } catch (...) {
+        fail("Unknown error");
+    }
+    return nullptr;
+}
+
+TSP_API void tsp_instance_destroy(tsp_instance* instance) {
+    delete instance;
+}
+
+TSP_API size_t tsp_instance_size(const tsp_instance* instance) {
+    return instance ? instance->instance->size() : 0;
+}
+
+TSP_API tsp_status tsp_solve(const tsp_instance* instance, const tsp_options* options,
+                             int* tour, double* length) {
+    return solve(instance, options, nullptr, 0, tour, length);
+}
+
+TSP_API tsp_status tsp_solve_subset(const tsp_instance* instance, const tsp_options* options,
+                                    const int* cities, size_t count, int* tour, double* length) {
+    if (!cities) return fail("cities must not be NULL");
+    return solve(instance, options, cities, count, tour, length);
+}
+
+TSP_API const char* tsp_last_error(void) {
+    return lastError.c_str();
+}
+
+} // extern "C"
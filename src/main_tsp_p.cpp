@@ -1,238 +1,460 @@
-#include <iostream>
-#include <vector>
-#include <random>
-#include <algorithm>
-#include <limits>
-#include <fstream>
-#include <sstream>
-#include <string>
-#include <omp.h>  // OpenMP for parallelization
+#include <cctype>
+#include <iomanip>
+
+#include "tsp_solver.hpp"
 
 /**
- * @class TSPSolver
- * @brief Parallel implementation of TSP solver using Shotgun Hill Climbing algorithm
- * 
- * This class implements a parallel version of the Traveling Salesman Problem solver
- * using the Shotgun Hill Climbing heuristic with 2-opt local search optimization.
- * The parallelization is achieved through OpenMP, distributing multiple restarts
- * across available CPU threads to explore the solution space more efficiently.
+ * @brief Parses a byte count such as 512M or 2G (binary multiples)
+ * @throws std::runtime_error on an unknown suffix
  */
-class TSPSolver {
-public:
-    /**
-     * @brief Constructor that initializes the solver with a base seed
-     * @param seed Base seed for random number generation across threads
-     */
-    TSPSolver(unsigned seed)
-        : baseSeed_(seed) {
-        loadAdjacencyMatrix(); // Load distance matrix from stdin
+size_t parseSize(const std::string& value) {
+    size_t end = 0;
+    double number = std::stod(value, &end);
+    std::string suffix = value.substr(end);
+    if (!suffix.empty() && (suffix.back() == 'B' || suffix.back() == 'b')) suffix.pop_back();
+    if (suffix.size() > 1 && suffix.back() == 'i') suffix.pop_back();
+    size_t shift = 0;
+    if (!suffix.empty()) {
+        size_t unit = suffix.size() == 1 ? std::string("KMGT").find(std::toupper(suffix[0]))
+                                         : std::string::npos;
+        if (unit == std::string::npos) throw std::runtime_error("Unknown size suffix: " + value);
+        shift = 10 * (unit + 1);
     }
+    return static_cast<size_t>(number * static_cast<double>(size_t(1) << shift));
+}
 
-    /**
-     * @brief Main solving method that orchestrates the parallel TSP solving process
-     * @param numIterations Maximum iterations per hill climbing run
-     * @param numRestarts Total number of random restarts to perform
-     * @return Best tour found as a vector of city indices
-     */
-    std::vector<int> solveTSP(int numIterations, int numRestarts) {
-        return shotgunHillClimbingParallel(numIterations, numRestarts);
+/**
+ * @brief Parses optional command line flags of the form --name or --name=value
+ * @throws std::runtime_error on unknown flags or invalid values
+ *
+ * Supported flags:
+ * - --vnd=2opt,2optnl,oropt,swap,or3opt,lk,bs  operator chain, cheapest first (default: 2opt)
+ * - --vnd-adaptive            re-rank the chain by evaluations per unit of gain
+ * - --neighbors=K             candidate list size for neighbour-driven operators
+ * - --segment-length=L        longest segment moved by or3opt (default: 3)
+ * - --bs-width=K              bs window: best order in which no city passes one K or more
+ *                             positions away (2..10, default 6); a late polish step
+ * - --multilevel[=N]          coarsen to at most N nodes (default 100), solve, refine upwards
+ * - --init=random|diverse     starting tours: uniform permutations or diversity-aware greedy
+ * - --max-overlap=F           diverse init: max share of edges reused from explored tours
+ * - --perturb=P               diverse init: probability of skipping the nearest candidate
+ * - --engine=auto|exact|sequential|restarts|intra|nested|interleaved|simd|lns
+ *                             solution strategy (default: auto); lns improves one tour by
+ *                             destroy/repair rounds, one attempt per thread, and reads the
+ *                             restart count as the number of rounds
+ * - --interleave=G            interleaved engine: descents in flight per thread (default 4)
+ * - --lns-remove=R            lns: cities removed per attempt (default n/20, within 5..60)
+ * - --lns-repair=regret|cheapest  lns: reinsertion order (default: regret)
+ * - --lns-polish              lns: run the --vnd chain on every repaired tour
+ * - --threads=N               thread count / core budget (default: OpenMP maximum)
+ * - --quantize                prescreen 2-opt moves on an 8-bit copy of the matrix
+ * - --input=FILE              read line 1 and the CSV matrix from FILE instead of stdin;
+ *                             gzip and zstd files are decompressed while parsing
+ * - --convert=FILE            write the CSV matrix from stdin to a binary file and exit
+ * - --matrix=FILE             map a binary matrix (out-of-core); stdin holds only line 1
+ * - --publish=NAME            copy the CSV matrix into shared memory segment NAME and exit
+ * - --attach=NAME             solve a published matrix; stdin holds only line 1
+ * - --unpublish=NAME          remove a published segment and exit
+ * - --coords=FILE             solve a TSPLIB file (EUC_2D, CEIL_2D, ATT, GEO, or EXPLICIT
+ *                             FULL_MATRIX / triangular rows; optionally gzip/zstd); rows are
+ *                             computed or unfolded when first read and kept in the row
+ *                             cache; stdin holds only line 1
+ * - --row-cache=R             mapped matrix: cache R rows per thread (default: off);
+ *                             --coords: R rows per thread (default: 64 MiB worth)
+ * - --cache-policy=lru|clock  row cache eviction order (default: lru)
+ * - --subsets=FILE            solve each line of FILE (city indices) as its own tour
+ * - --gather[=M]              copy subsets of at most M cities (default: all) into a
+ *                             compact matrix instead of reading through an index view
+ * - --jobs=FILE               run the jobs in FILE side by side on --threads cores, one per
+ *                             line: AFTER PRIORITY CORES ITERATIONS RESTARTS SEED [CITY...]
+ *                             (submitted AFTER seconds from the start; PRIORITY latency,
+ *                             normal or batch; no cities means all); more urgent jobs
+ *                             preempt less urgent ones; jobs use the restarts engine
+ * - --mem-limit=SIZE         choose the matrix representation, row caches and tables to
+ *                             fit SIZE bytes (suffix K, M, G or T): a CSV matrix is held
+ *                             dense, as a triangle, or spilled to disk and mapped; implies
+ *                             --mem-report
+ * - --mem-report              print the memory plan and peak RSS of load, preprocess and
+ *                             solve to stderr
+ * - --progress[=S]             print best length, elapsed time and restarts done to stderr
+ *                             at most every S seconds (default 1)
+ * - --time-limit=S            cancel the search after S seconds and print the best tour so far;
+ *                             with --subsets or --jobs the limit covers the whole file
+ * - --stats                   print per-operator statistics to stderr
+ */
+SearchOptions parseOptions(int argc, char* argv[]) {
+    SearchOptions options;
+    for (int k = 1; k < argc; ++k) {
+        std::string arg = argv[k];
+        std::string name = arg.substr(0, arg.find('='));
+        std::string value = arg.find('=') == std::string::npos ? "" : arg.substr(arg.find('=') + 1);
+
+        if (name == "--vnd") {
+            options.chain.clear();
+            for (const std::string& op : splitList(value)) {
+                options.chain.push_back(parseOperatorName(op));
+            }
+            if (options.chain.empty()) {
+                throw std::runtime_error("--vnd needs at least one operator");
+            }
+        } else if (name == "--vnd-adaptive") {
+            options.adaptiveOrder = true;
+        } else if (name == "--neighbors") {
+            options.neighborListSize = std::stoi(value);
+        } else if (name == "--segment-length") {
+            options.maxSegmentLength = std::stoi(value);
+            if (options.maxSegmentLength < 1) {
+                throw std::runtime_error("--segment-length must be at least 1");
+            }
+        } else if (name == "--bs-width") {
+            options.windowWidth = std::stoi(value);
+            if (options.windowWidth < 2 || options.windowWidth > TSPSolver::kMaxWindowWidth) {
+                throw std::runtime_error("--bs-width must be between 2 and " +
+                                         std::to_string(TSPSolver::kMaxWindowWidth));
+            }
+        } else if (name == "--multilevel") {
+            options.multilevel = true;
+            if (!value.empty()) options.coarsestSize = std::stoi(value);
+        } else if (name == "--init") {
+            if (value == "random") {
+                options.init = InitStrategy::Random;
+            } else if (value == "diverse") {
+                options.init = InitStrategy::Diverse;
+            } else {
+                throw std::runtime_error("Unknown initialization: " + value);
+            }
+        } else if (name == "--max-overlap") {
+            options.maxEdgeOverlap = std::stod(value);
+        } else if (name == "--perturb") {
+            options.perturbation = std::stod(value);
+        } else if (name == "--engine") {
+            options.engine = parseEngineName(value);
+        } else if (name == "--threads") {
+            options.threads = std::stoi(value);
+            if (options.threads < 1) throw std::runtime_error("--threads must be at least 1");
+        } else if (name == "--interleave") {
+            options.interleave = std::stoi(value);
+            if (options.interleave < 1) throw std::runtime_error("--interleave must be at least 1");
+        } else if (name == "--lns-remove") {
+            options.lnsRemove = std::stoi(value);
+            if (options.lnsRemove < 1) throw std::runtime_error("--lns-remove must be at least 1");
+        } else if (name == "--lns-repair") {
+            if (value == "regret") {
+                options.regretRepair = true;
+            } else if (value == "cheapest") {
+                options.regretRepair = false;
+            } else {
+                throw std::runtime_error("Unknown LNS repair: " + value);
+            }
+        } else if (name == "--lns-polish") {
+            options.lnsPolish = true;
+        } else if (name == "--quantize") {
+            options.quantize = true;
+        } else if (name == "--convert") {
+            options.convertFile = value;
+            if (value.empty()) throw std::runtime_error("--convert needs a file name");
+        } else if (name == "--input") {
+            options.inputFile = value;
+            if (value.empty()) throw std::runtime_error("--input needs a file name");
+        } else if (name == "--matrix") {
+            options.matrixFile = value;
+            if (value.empty()) throw std::runtime_error("--matrix needs a file name");
+        } else if (name == "--publish" || name == "--attach" || name == "--unpublish") {
+            if (value.empty()) throw std::runtime_error(name + " needs a segment name");
+            std::string& target = name == "--publish" ? options.publishName
+                                : name == "--attach" ? options.attachName
+                                                     : options.unpublishName;
+            target = value;
+        } else if (name == "--subsets") {
+            options.subsetsFile = value;
+            if (value.empty()) throw std::runtime_error("--subsets needs a file name");
+        } else if (name == "--jobs") {
+            options.jobsFile = value;
+            if (value.empty()) throw std::runtime_error("--jobs needs a file name");
+        } else if (name == "--gather") {
+            options.gatherLimit = value.empty() ? std::numeric_limits<size_t>::max()
+                                                : std::stoul(value);
+        } else if (name == "--row-cache") {
+            options.rowCacheRows = std::stoul(value);
+        } else if (name == "--cache-policy") {
+            if (value == "lru") {
+                options.rowCachePolicy = RowCache::Policy::Lru;
+            } else if (value == "clock") {
+                options.rowCachePolicy = RowCache::Policy::Clock;
+            } else {
+                throw std::runtime_error("Unknown cache policy: " + value);
+            }
+        } else if (name == "--coords") {
+            options.coordsFile = value;
+            if (value.empty()) throw std::runtime_error("--coords needs a file name");
+        } else if (name == "--mem-limit") {
+            options.memoryLimit = parseSize(value);
+            if (options.memoryLimit == 0) throw std::runtime_error("--mem-limit must be positive");
+            options.memoryReport = true;
+        } else if (name == "--mem-report") {
+            options.memoryReport = true;
+        } else if (name == "--progress") {
+            options.progressInterval = value.empty() ? 1.0 : std::stod(value);
+            if (options.progressInterval <= 0.0) {
+                throw std::runtime_error("--progress needs a positive interval");
+            }
+            options.progress = [](const SearchProgress& progress) {
+                std::cerr << "progress: " << progress.restartsDone << "/"
+                          << progress.restartsTotal << " restarts, best " << progress.best
+                          << ", " << progress.elapsedSeconds << " s" << std::endl;
+            };
+        } else if (name == "--time-limit") {
+            options.timeLimit = std::stod(value);
+            if (options.timeLimit <= 0.0) throw std::runtime_error("--time-limit must be positive");
+        } else if (name == "--stats") {
+            options.printStats = true;
+        } else {
+            throw std::runtime_error("Unknown option: " + arg);
+        }
     }
+    return options;
+}
 
+/**
+ * @class Deadline
+ * @brief Cancels a token once a time limit has passed, unless disarmed first
+ */
+class Deadline {
+public:
     /**
-     * @brief Calculates the total length/cost of a given tour
-     * @param tour Vector representing the sequence of cities to visit
-     * @return Total distance of the tour
+     * @param seconds Time limit (0: never fires)
+     * @param token Token to cancel
      */
-    double calculateTourLength(const std::vector<int>& tour) const {
-        double length = 0.0;
-        // Sum distances between consecutive cities + return to start
-        for (size_t i = 0; i < tour.size(); ++i) {
-            length += adjacencyMatrix_[tour[i]][tour[(i + 1) % tour.size()]];
-        }
-        return length;
+    Deadline(double seconds, CancellationToken token) {
+        if (seconds <= 0.0) return;
+        watcher_ = std::thread([this, seconds, token]() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (!disarmed_.wait_for(lock, std::chrono::duration<double>(seconds),
+                                    [this] { return done_; })) {
+                token.cancel();
+            }
+        });
     }
 
-private:
-    std::vector<std::vector<double>> adjacencyMatrix_; ///< Distance matrix between cities
-    unsigned baseSeed_; ///< Base seed for generating unique seeds per thread
+    ~Deadline() { disarm(); }
 
     /**
-     * @brief Loads the adjacency matrix from standard input (CSV format)
-     * @throws std::runtime_error if matrix is invalid or not square
+     * @brief Stops the watch; the token is left as it is
      */
-    void loadAdjacencyMatrix() {
-        std::string line;
-        // Read CSV lines from stdin
-        while (std::getline(std::cin, line)) {
-            adjacencyMatrix_.push_back(parseCSVLine(line));
-        }
-
-        // Validate matrix integrity
-        if (adjacencyMatrix_.empty() || !isSquareMatrix()) {
-            throw std::runtime_error("Invalid adjacency matrix in CSV file");
+    void disarm() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_ = true;
         }
+        disarmed_.notify_all();
+        if (watcher_.joinable()) watcher_.join();
     }
 
-    /**
-     * @brief Parses a CSV line into a vector of doubles
-     * @param line Comma-separated string of numbers
-     * @return Vector of parsed double values
-     */
-    std::vector<double> parseCSVLine(const std::string& line) {
-        std::vector<double> row;
-        std::stringstream ss(line);
-        std::string cell;
-        // Split by comma and convert to double
-        while (std::getline(ss, cell, ',')) {
-            row.push_back(std::stod(cell));
-        }
-        return row;
+private:
+    std::mutex mutex_;
+    std::condition_variable disarmed_;
+    bool done_ = false;
+    std::thread watcher_;
+};
+
+/**
+ * @brief Prints the per-operator statistics of the last solve to stderr
+ */
+void printOperatorStats(const TSPSolver& solver) {
+    const auto& chain = solver.operatorChain();
+    const auto& stats = solver.operatorStats();
+    std::cerr << "operator  calls  evaluations  improvements  gain  seconds  evals/gain  verified"
+              << std::endl;
+    for (size_t k = 0; k < chain.size(); ++k) {
+        const OperatorStats& st = stats[k];
+        std::cerr << operatorName(chain[k]) << "  " << st.calls << "  " << st.evaluations
+                  << "  " << st.improvements << "  " << st.gain << "  " << st.seconds << "  "
+                  << (st.gain > 0.0 ? st.evaluations / st.gain : 0.0) << "  "
+                  << st.verifications << std::endl;
     }
 
-    /**
-     * @brief Validates that the loaded matrix is square (n×n)
-     * @return True if matrix is square, false otherwise
-     */
-    bool isSquareMatrix() const {
-        size_t size = adjacencyMatrix_.size();
-        return std::all_of(adjacencyMatrix_.begin(), adjacencyMatrix_.end(),
-                           [size](const auto& row) { return row.size() == size; });
+    const DistanceMatrix& matrix = solver.distanceMatrix();
+    if (matrix.hasRowCache()) {
+        auto [hits, misses] = matrix.rowCacheStats();
+        std::cerr << "row cache: " << hits << " hits, " << misses << " misses" << std::endl;
     }
+}
 
-    /**
-     * @brief Generates a random permutation tour starting from city 0
-     * @param gen Random number generator for this thread
-     * @return Random tour as vector of city indices
-     */
-    std::vector<int> generateRandomTour(std::mt19937& gen) {
-        std::vector<int> tour(adjacencyMatrix_.size());
-        std::iota(tour.begin(), tour.end(), 0); // Fill with 0,1,2,...,n-1
-        std::shuffle(tour.begin() + 1, tour.end(), gen); // Keep city 0 fixed, shuffle rest
-        return tour;
+/**
+ * @brief Bytes in MiB, for the memory report
+ */
+double mebibytes(size_t bytes) {
+    return static_cast<double>(bytes) / (1 << 20);
+}
+
+/**
+ * @brief Prints a memory plan and what it gave up to stderr
+ */
+void printMemoryPlan(const MemoryPlan& plan, const MemoryBudget& budget) {
+    std::ostringstream report; // Local formatting leaves std::cerr's precision alone
+    report << std::fixed << std::setprecision(1) << "memory plan: "
+           << storageName(plan.storage) << " matrix";
+    if (plan.rowCacheRows > 0) report << ", " << plan.rowCacheRows << " cached rows per thread";
+    report << "; matrix " << mebibytes(plan.matrixBytes) << " MiB, row caches "
+           << mebibytes(plan.cacheBytes) << " MiB, tables " << mebibytes(plan.tableBytes)
+           << " MiB, solve " << mebibytes(plan.solveBytes) << " MiB, total "
+           << mebibytes(plan.totalBytes()) << " MiB";
+    if (budget.limitBytes > 0) report << " of " << mebibytes(budget.limitBytes) << " MiB";
+    report << "\n";
+    if (budget.tables.quantize && !plan.quantize) {
+        report << "memory plan: dropped the quantized copy\n";
     }
+    if (budget.edgeBitmap && !plan.edgeBitmap) {
+        report << "memory plan: dropped the edge bitmap (random starts)\n";
+    }
+    std::cerr << report.str() << std::flush;
+}
 
-    /**
-     * @brief Performs 2-opt swap operation on a tour
-     * @param tour Original tour to modify
-     * @param i Start index of the segment to reverse
-     * @param j End index of the segment to reverse
-     * @return New tour with reversed segment between i and j
-     * 
-     * 2-opt removes two edges and reconnects the tour in a different way,
-     * effectively reversing a segment of the tour to eliminate edge crossings
-     */
-    std::vector<int> twoOptSwap(const std::vector<int>& tour, int i, int j) {
-        std::vector<int> newTour = tour;
-        std::reverse(newTour.begin() + i, newTour.begin() + j + 1); // Reverse segment [i,j]
-        return newTour;
+/**
+ * @brief Prints the peak RSS of every finished phase to stderr
+ */
+void printPeakMemory(const PeakMemory& peaks) {
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(1)
+           << (peaks.perPhase() ? "peak RSS:" : "peak RSS (cumulative):");
+    const char* separator = " ";
+    for (const auto& [phase, bytes] : peaks.phases()) {
+        report << separator << phase << " " << mebibytes(bytes) << " MiB";
+        separator = ", ";
     }
+    std::cerr << report.str() << std::endl;
+}
 
-    /**
-     * @brief Parallel implementation of shotgun hill climbing using OpenMP
-     * @param numIterations Maximum iterations per hill climb
-     * @param numRestarts Total number of random restarts
-     * @return Best tour found across all threads
-     * 
-     * This method distributes the restarts across multiple threads, where each
-     * thread runs independent hill climbing instances with different random seeds.
-     * The best solution found by any thread is returned.
-     */
-    std::vector<int> shotgunHillClimbingParallel(int numIterations, int numRestarts) {
-        std::vector<int> bestTour;
-        double bestLength = std::numeric_limits<double>::max();
+/**
+ * @brief Solves every subset listed in options.subsetsFile over the loaded master matrix
+ * @throws std::runtime_error if the file cannot be read or a subset is invalid
+ *
+ * Each non-empty line holds master city indices separated by commas or spaces.
+ * Results are printed per subset in the usual format, tours in master indices.
+ */
+void solveSubsets(TSPSolver& solver, const SearchOptions& options, int numIterations,
+                  int numRestarts) {
+    std::ifstream in(options.subsetsFile);
+    if (!in) throw std::runtime_error("Cannot open " + options.subsetsFile);
 
-        // Parallel region - each thread executes this block
-        #pragma omp parallel
-        {
-            // Each thread gets unique random generator with different seed
-            int threadId = omp_get_thread_num();
-            std::mt19937 localGen(baseSeed_ + threadId);
-            
-            // Thread-local variables to avoid race conditions
-            std::vector<int> localBestTour;
-            double localBestLength = std::numeric_limits<double>::max();
-
-            // Distribute restarts among threads using OpenMP work-sharing
-            #pragma omp for
-            for (int restart = 0; restart < numRestarts; ++restart) {
-                // Run hill climbing from random starting point
-                auto [currentTour, currentLength] = hillClimb(numIterations, localGen);
-
-                // Update thread-local best if improvement found
-                if (currentLength < localBestLength) {
-                    localBestTour = currentTour;
-                    localBestLength = currentLength;
-                }
-            }
+    std::string line;
+    int index = 0;
+    while (std::getline(in, line)) {
+        std::replace(line.begin(), line.end(), ',', ' ');
+        std::istringstream fields(line);
+        std::vector<int> cities;
+        for (int city; fields >> city; ) cities.push_back(city);
+        if (cities.empty()) continue;
 
-            // Critical section to safely compare results from all threads
-            #pragma omp critical
-            {
-                if (localBestLength < bestLength) {
-                    bestTour = std::move(localBestTour); // Move semantics for efficiency
-                    bestLength = localBestLength;
-                }
-            }
-        } // End of parallel region
+        bool gather = cities.size() <= options.gatherLimit;
+        std::vector<int> tour = solver.solveSubset(cities, numIterations, numRestarts, gather);
+        std::cout << "Subset " << index++ << " (" << cities.size() << " cities"
+                  << (gather ? ", gathered" : "") << ")" << std::endl;
+        std::cout << "Best tour found: ";
+        for (int vertex : tour) {
+            std::cout << vertex << " ";
+        }
+        std::cout << "\nTour length: " << solver.calculateTourLength(tour) << std::endl;
+    }
 
-        return bestTour;
+    if (options.printStats) {
+        printOperatorStats(solver);
     }
+}
 
-    /**
-     * @brief Single hill climbing run with 2-opt local search
-     * @param numIterations Maximum iterations before giving up
-     * @param gen Random number generator for this instance
-     * @return Pair of (best tour found, tour length)
-     * 
-     * Hill climbing explores the neighborhood of the current solution using
-     * 2-opt moves, always accepting improvements (greedy local search).
-     * Stops when no improvement is found or max iterations reached.
-     */
-    std::pair<std::vector<int>, double> hillClimb(int numIterations, std::mt19937& gen) {
-        std::vector<int> currentTour = generateRandomTour(gen); // Start with random tour
-        double currentLength = calculateTourLength(currentTour);
-
-        // Hill climbing main loop
-        for (int iter = 0; iter < numIterations; ++iter) {
-            bool improvement = false;
-            
-            // Try all possible 2-opt swaps
-            for (size_t i = 1; i < currentTour.size() - 1; ++i) {
-                for (size_t j = i + 1; j < currentTour.size(); ++j) {
-                    std::vector<int> newTour = twoOptSwap(currentTour, i, j);
-                    double newLength = calculateTourLength(newTour);
-                    
-                    // Accept first improvement found (first-improvement strategy)
-                    if (newLength < currentLength) {
-                        currentTour = std::move(newTour);
-                        currentLength = newLength;
-                        improvement = true;
-                        break; // Exit inner loop
-                    }
-                }
-                if (improvement) break; // Exit outer loop
-            }
-            
-            // If no improvement found, we've reached local optimum
-            if (!improvement) break;
+/**
+ * @brief Runs every job listed in options.jobsFile through a JobScheduler
+ * @throws std::runtime_error if the file cannot be read or a line is malformed
+ *
+ * Jobs are submitted at their arrival offsets and reported in file order, with
+ * the time each spent queued, in service and parked for more urgent jobs.
+ */
+void solveJobs(const TSPSolver& solver, const SearchOptions& options) {
+    std::ifstream in(options.jobsFile);
+    if (!in) throw std::runtime_error("Cannot open " + options.jobsFile);
+
+    JobScheduler scheduler(solver.instance(), options.threads);
+    std::vector<std::pair<double, Job>> jobs;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::replace(line.begin(), line.end(), ',', ' ');
+        std::istringstream fields(line);
+        double after;
+        std::string priority;
+        Job job;
+        if (!(fields >> after >> priority >> job.cores >> job.iterations >> job.restarts >>
+              job.seed)) {
+            throw std::runtime_error("Invalid job line: " + line);
+        }
+        job.priority = parsePriorityName(priority);
+        if (job.cores < 1 || job.cores > scheduler.cores()) {
+            // Checked here so that a bad line stops the run before any job starts
+            throw std::runtime_error("Job needs 1 to " + std::to_string(scheduler.cores()) +
+                                     " cores: " + line);
         }
+        for (int city; fields >> city; ) job.cities.push_back(city);
+        job.options = options;
+        jobs.emplace_back(after, std::move(job));
+    }
 
-        return {currentTour, currentLength};
+    std::vector<std::future<JobResult>> results;
+    double begin = omp_get_wtime();
+    for (auto& [after, job] : jobs) {
+        double wait = begin + after - omp_get_wtime();
+        if (wait > 0) std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+        results.push_back(scheduler.submit(job));
     }
-};
+
+    for (size_t k = 0; k < jobs.size(); ++k) {
+        JobResult result = results[k].get();
+        const Job& job = jobs[k].second;
+        std::cout << "Job " << k << " (" << priorityName(job.priority) << ", " << job.cores
+                  << (job.cores == 1 ? " core" : " cores") << "): queued " << result.queueSeconds
+                  << " s, service " << result.serviceSeconds << " s, preempted "
+                  << result.preemptedSeconds << " core-s" << std::endl;
+        std::cout << "Best tour found: ";
+        for (int vertex : result.tour) {
+            std::cout << vertex << " ";
+        }
+        std::cout << "\nTour length: " << result.length << std::endl;
+    }
+}
 
 /**
  * @brief Main function that handles input parsing and orchestrates the TSP solving
  * 
  * Expected input format:
  * Line 1: numIterations numRestarts seed
- * Following lines: CSV adjacency matrix
+ * Following lines: CSV adjacency matrix (omitted with --matrix, --coords and --attach)
+ *
+ * Optional flags (see parseOptions) select the local search operators. With
+ * --matrix the distances come from a mapped binary file and with --coords they
+ * are computed from coordinates or read from a triangle; in all cases, unless --vnd or --init
+ * say otherwise the search then only touches candidate-list entries (2optnl and
+ * or3opt from greedy starts), so the working set stays O(n k) rather than O(n^2).
  */
 int main(int argc, char* argv[]) {
     try {
+        SearchOptions options = parseOptions(argc, argv);
+        if (!options.unpublishName.empty()) {
+            DistanceMatrix::unpublish(options.unpublishName);
+            return 0;
+        }
+
+        // Input comes from stdin or, with --input, from a possibly compressed file
+        std::unique_ptr<CompressedInput> inputFile;
+        std::unique_ptr<std::istream> inputStream;
+        if (!options.inputFile.empty()) {
+            inputFile = std::make_unique<CompressedInput>(options.inputFile);
+            inputStream = std::make_unique<std::istream>(inputFile.get());
+            inputStream->exceptions(std::ios::badbit); // Surface decode errors
+        }
+        std::istream& input = inputStream ? *inputStream : std::cin;
+
         // Parse command line parameters from first line of input
         std::string line;
-        std::getline(std::cin, line);
+        std::getline(input, line);
         std::stringstream myStream(line);
         
         std::getline(myStream, line, ' ');
@@ -244,12 +466,123 @@ int main(int argc, char* argv[]) {
         std::getline(myStream, line, ' ');
         unsigned seed = std::stoi(line);      // Base random seed
 
+        if (!options.convertFile.empty()) {
+            size_t n = Instance::convertToBinary(input, options.convertFile);
+            std::cout << "Wrote " << n << "x" << n << " matrix to " << options.convertFile
+                      << std::endl;
+            return 0;
+        }
+
+        // Create solver and pick engine and thread count for this instance
+        PeakMemory peaks;
+        if (options.memoryReport) peaks.start("load");
+        MemoryBudget budget;
+        MemoryPlan memoryPlan;
+        std::unique_ptr<TSPSolver> solverPtr;
+        if (!options.attachName.empty()) {
+            solverPtr = std::make_unique<TSPSolver>(
+                DistanceMatrix::attachShared(options.attachName, options.rowCacheRows,
+                                             options.rowCachePolicy), seed);
+            budget = TSPSolver::memoryBudget(options);
+            memoryPlan = budget.plan(solverPtr->distanceMatrix().size(),
+                                     MemoryPlan::Source::Mapped);
+        } else if (options.matrixFile.empty() && options.coordsFile.empty()) {
+            // Build the tables this search needs while the CSV is still being parsed;
+            // subsets build their own and a published matrix needs none
+            bool eagerTables = options.publishName.empty() && options.subsetsFile.empty();
+            Preprocessing preprocessing;
+            if (eagerTables) preprocessing = TSPSolver::preprocessingFor(options);
+            budget = TSPSolver::memoryBudget(options);
+            solverPtr = std::make_unique<TSPSolver>(
+                Instance::fromCSV(input, preprocessing, budget, &memoryPlan), seed);
+            if (!options.publishName.empty()) {
+                solverPtr->distanceMatrix().publish(options.publishName);
+                std::cout << "Published " << solverPtr->distanceMatrix().size()
+                          << "-city matrix as " << options.publishName << std::endl;
+                return 0;
+            }
+        } else {
+            bool chainGiven = false, initGiven = false;
+            for (int k = 1; k < argc; ++k) {
+                std::string arg = argv[k];
+                chainGiven = chainGiven || arg.rfind("--vnd=", 0) == 0;
+                initGiven = initGiven || arg.rfind("--init=", 0) == 0;
+            }
+            if (!chainGiven) {
+                options.chain = {MoveOperator::TwoOptNeighbors, MoveOperator::SegmentInsertion};
+            }
+            if (!initGiven) options.init = InitStrategy::Diverse;
+            budget = TSPSolver::memoryBudget(options);
+            if (!options.coordsFile.empty()) {
+                CompressedInput coordsFile(options.coordsFile);
+                std::istream coordsStream(&coordsFile);
+                coordsStream.exceptions(std::ios::badbit);
+                TSPLIBHeader header = TSPLIBHeader::read(coordsStream);
+                memoryPlan = budget.plan(header.dimension, header.edgeWeightType == "EXPLICIT"
+                                                               ? MemoryPlan::Source::Explicit
+                                                               : MemoryPlan::Source::Coordinates);
+                solverPtr = std::make_unique<TSPSolver>(
+                    DistanceMatrix::fromTSPLIB(header, coordsStream, memoryPlan.rowCacheRows,
+                                               options.rowCachePolicy), seed);
+            } else {
+                solverPtr = std::make_unique<TSPSolver>(
+                    DistanceMatrix::mapFile(options.matrixFile, options.rowCacheRows,
+                                            options.rowCachePolicy), seed);
+                memoryPlan = budget.plan(solverPtr->distanceMatrix().size(),
+                                         MemoryPlan::Source::Mapped);
+            }
+        }
+        // Tables the plan could not afford under --mem-limit are left out of the search
+        bool limited = budget.limitBytes > 0;
+        options.quantize = options.quantize && (!limited || memoryPlan.quantize);
+        if (options.init == InitStrategy::Diverse && limited && !memoryPlan.edgeBitmap) {
+            options.init = InitStrategy::Random;
+        }
+        if (options.memoryReport) printMemoryPlan(memoryPlan, budget);
+
+        TSPSolver& solver = *solverPtr;
+        solver.configureSearch(options);
+        if (options.memoryReport) {
+            peaks.start("preprocess");
+            if (options.subsetsFile.empty()) {
+                solver.instance()->prepare(TSPSolver::preprocessingFor(options));
+            }
+            peaks.start("solve");
+        }
+        if (!options.subsetsFile.empty() || !options.jobsFile.empty()) {
+            // One limit for the whole file: once it passes, the remaining solves stop early
+            Deadline deadline(options.timeLimit, options.cancelToken);
+            if (options.jobsFile.empty()) {
+                solveSubsets(solver, options, numIterations, numRestarts);
+            } else {
+                solveJobs(solver, options);
+            }
+            deadline.disarm();
+            if (options.cancelToken.cancelled()) {
+                std::cerr << "search cancelled at the time limit" << std::endl;
+            }
+            if (options.memoryReport) {
+                peaks.stop();
+                printPeakMemory(peaks);
+            }
+            return 0;
+        }
+
+        ExecutionPlan plan = solver.planExecution(numIterations, numRestarts);
+
         // Display parallelization info
-        std::cout << "Using " << omp_get_max_threads() << " threads" << std::endl;
+        std::cout << "Using " << plan.threads << " threads" << std::endl;
+        if (options.printStats) {
+            std::cerr << "engine: " << engineName(plan.engine) << " (estimated "
+                      << plan.estimatedSeconds << " s)" << std::endl;
+        }
 
-        // Create solver and find best tour
-        TSPSolver solver(seed);
-        std::vector<int> bestTour = solver.solveTSP(numIterations, numRestarts);
+        Deadline deadline(options.timeLimit, options.cancelToken);
+        std::vector<int> bestTour = solver.solveTSP(numIterations, numRestarts, plan);
+        deadline.disarm();
+        if (solver.cancelled()) {
+            std::cerr << "search cancelled at the time limit" << std::endl;
+        }
 
         // Output results
         std::cout << "Best tour found: ";
@@ -257,7 +590,14 @@ int main(int argc, char* argv[]) {
             std::cout << vertex << " ";
         }
         std::cout << "\nTour length: " << solver.calculateTourLength(bestTour) << std::endl;
-        
+
+        if (options.printStats) {
+            printOperatorStats(solver);
+        }
+        if (options.memoryReport) {
+            peaks.stop();
+            printPeakMemory(peaks);
+        }
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
         return 1;
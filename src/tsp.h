@@ -0,0 +1,134 @@
+/**
+ * @file tsp.h
+ * @brief C interface of the parallel TSP solver (libtsp)
+ *
+ * Build the shared library with
+ *   g++ -fopenmp -O3 -std=c++17 -shared -fPIC -fvisibility=hidden src/libtsp.cpp -o libtsp.so
+ * and the Python module (src/tsp_python.cpp, needs pybind11 and numpy) with
+ *   g++ -fopenmp -O3 -std=c++17 -shared -fPIC $(python3 -m pybind11 --includes) \
+ *       src/tsp_python.cpp -o tsp$(python3-config --extension-suffix)
+ * testes_comp.bash builds and smoke-tests the module when pybind11 is installed.
+ *
+ * An instance wraps a caller-owned distance matrix. Matrices of every dtype are
+ * used in place (zero copy) for any row stride; the caller keeps that memory alive
+ * and unchanged until tsp_instance_destroy. Several threads may call tsp_solve
+ * on the same instance at once. No C++ exception crosses this interface:
+ * failures return TSP_ERROR and tsp_last_error() describes them.
+ */
+#ifndef TSP_H
+#define TSP_H
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#define TSP_API __declspec(dllexport)
+#else
+#define TSP_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Element type of a matrix passed to tsp_instance_create
+ */
+typedef enum {
+    TSP_FLOAT64 = 0, /**< double, used in place */
+    TSP_FLOAT32 = 1, /**< float, used in place and read as double */
+    TSP_INT32 = 2    /**< int32_t, used in place and read as double */
+} tsp_dtype;
+
+/**
+ * @brief Result of a library call
+ */
+typedef enum {
+    TSP_OK = 0,        /**< Success */
+    TSP_CANCELLED = 1, /**< Stopped by the cancel callback; the best tour so far is returned */
+    TSP_ERROR = -1     /**< Failure, see tsp_last_error() */
+} tsp_status;
+
+/** @brief Opaque, immutable problem instance */
+typedef struct tsp_instance tsp_instance;
+
+/** @brief Called after every finished restart with (done, total, best length so far) */
+typedef void (*tsp_progress_fn)(void* user_data, int done, int total, double best);
+
+/** @brief Polled during the search; a nonzero return stops it */
+typedef int (*tsp_cancel_fn)(void* user_data);
+
+/**
+ * @brief Settings of one solve; fill with tsp_options_init before changing fields
+ *
+ * Callbacks may run on any solver thread but never concurrently with each other.
+ */
+typedef struct {
+    int iterations;           /**< Maximum improving moves per restart */
+    int restarts;             /**< Number of restarts */
+    unsigned seed;            /**< Base random seed */
+    int threads;              /**< Thread count, 0 lets the planner decide */
+    const char* vnd;          /**< Operator chain such as "2opt,or3opt", NULL for 2opt */
+    const char* engine;       /**< Engine name as for --engine, NULL for auto */
+    int neighbors;            /**< Candidate neighbours per city */
+    int quantize;             /**< Nonzero prescreens 2-opt moves on an 8-bit matrix */
+    tsp_progress_fn progress; /**< Optional progress callback */
+    tsp_cancel_fn cancel;     /**< Optional cancel callback */
+    void* user_data;          /**< Passed to both callbacks */
+} tsp_options;
+
+/**
+ * @brief Fills options with the command line defaults (1000 iterations, 10 restarts)
+ */
+TSP_API void tsp_options_init(tsp_options* options);
+
+/**
+ * @brief Creates an instance over a row-major n x n matrix
+ * @param data Entry (0, 0); row i starts at data + i * row_stride_bytes
+ * @param n Number of cities
+ * @param row_stride_bytes Distance between row starts, at least n elements and a
+ *        multiple of the element size; 0 means densely packed rows
+ * @param dtype Element type
+ * @return New instance, or NULL on error
+ */
+TSP_API tsp_instance* tsp_instance_create(const void* data, size_t n,
+                                          size_t row_stride_bytes, tsp_dtype dtype);
+
+/** @brief Releases an instance; NULL is ignored */
+TSP_API void tsp_instance_destroy(tsp_instance* instance);
+
+/** @brief Number of cities of an instance, 0 for NULL */
+TSP_API size_t tsp_instance_size(const tsp_instance* instance);
+
+/**
+ * @brief Solves the tour over all cities
+ * @param instance Instance to solve
+ * @param options Settings, NULL for defaults
+ * @param tour Output, tsp_instance_size(instance) city indices starting at city 0
+ * @param length Output tour length (may be NULL)
+ * @return TSP_OK, TSP_CANCELLED or TSP_ERROR
+ */
+TSP_API tsp_status tsp_solve(const tsp_instance* instance, const tsp_options* options,
+                             int* tour, double* length);
+
+/**
+ * @brief Solves the tour over a subset of an instance's cities
+ * @param cities Distinct city indices to visit
+ * @param count Number of entries in cities
+ * @param tour Output, count city indices of the instance starting at cities[0]
+ * @return TSP_OK, TSP_CANCELLED or TSP_ERROR
+ */
+TSP_API tsp_status tsp_solve_subset(const tsp_instance* instance, const tsp_options* options,
+                                    const int* cities, size_t count, int* tour, double* length);
+
+/**
+ * @brief Message of the last failed call on this thread ("" if none)
+ *
+ * The string stays valid until the next library call on the same thread.
+ */
+TSP_API const char* tsp_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TSP_H
@@ -0,0 +1,182 @@
+/**
+ * @file tsp_python.cpp
+ * @brief Python bindings (pybind11) of the parallel TSP solver
+ *
+ * Build the extension module with
+ *   g++ -fopenmp -O3 -std=c++17 -shared -fPIC $(python3 -m pybind11 --includes) \
+ *       src/tsp_python.cpp -o tsp$(python3-config --extension-suffix)
+ *
+ * Usage:
+ *   import numpy as np, tsp
+ *   instance = tsp.Instance(matrix)          # no copy
+ *   tour, length = tsp.solve(instance, iterations=2000, restarts=8, seed=17)
+ *
+ * Matrices come in through the buffer protocol. Float64, float32 and int32
+ * matrices are read in place for any row stride, and the Instance keeps them
+ * alive; the kernels convert entries to doubles as they read them.
+ * The GIL is released while solving, so several Python threads can solve at
+ * once, and Ctrl-C stops a solve like the cancel callback does.
+ */
+#include <optional>
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+
+#include "tsp_solver.hpp"
+
+namespace py = pybind11;
+
+/**
+ * @struct PyInstance
+ * @brief Python-side instance: the shared solver instance plus the buffer it borrows
+ */
+struct PyInstance {
+    std::shared_ptr<const Instance> instance; ///< Problem data shared by every solve
+    py::object owner;                         ///< Borrowed buffer, kept alive
+};
+
+/**
+ * @brief Wraps a 2-D buffer in an instance
+ * @param buffer Square float64, float32 or int32 matrix with contiguous rows
+ * @throws std::invalid_argument (ValueError) if the buffer cannot be used
+ */
+static PyInstance makeInstance(const py::buffer& buffer) {
+    py::buffer_info info = buffer.request();
+    if (info.ndim != 2 || info.shape[0] != info.shape[1] || info.shape[0] == 0) {
+        throw std::invalid_argument("matrix must be a non-empty square 2-D array");
+    }
+    size_t n = static_cast<size_t>(info.shape[0]);
+    py::ssize_t item = info.itemsize;
+    if (info.strides[1] != item || info.strides[0] % item != 0 ||
+        info.strides[0] < static_cast<py::ssize_t>(n) * item) {
+        throw std::invalid_argument("matrix rows must be contiguous "
+                                    "(use numpy.ascontiguousarray)");
+    }
+    size_t rowStride = static_cast<size_t>(info.strides[0] / item);
+
+    PyInstance result{nullptr, buffer};
+    if (py::format_descriptor<double>::compare(info.format)) {
+        result.instance = std::make_shared<const Instance>(
+            DistanceMatrix::borrow(static_cast<const double*>(info.ptr), n, rowStride));
+    } else if (py::format_descriptor<float>::compare(info.format)) {
+        result.instance = std::make_shared<const Instance>(
+            DistanceMatrix::borrow(static_cast<const float*>(info.ptr), n, rowStride));
+    } else if (py::format_descriptor<int32_t>::compare(info.format)) {
+        result.instance = std::make_shared<const Instance>(
+            DistanceMatrix::borrow(static_cast<const int32_t*>(info.ptr), n, rowStride));
+    } else {
+        throw std::invalid_argument("matrix dtype must be float64, float32 or int32");
+    }
+    return result;
+}
+
+/**
+ * @struct CallbackState
+ * @brief Python callbacks of one solve and the first error they raised
+ *
+ * The solver copies its options while the GIL is released, so the callbacks
+ * capture this state by shared_ptr instead of copying Python objects. Every
+ * access to a Python object happens with the GIL re-acquired.
+ */
+struct CallbackState {
+    py::object progress;        ///< progress(done, total, best) or None
+    py::object cancel;          ///< cancel() -> bool or None
+    std::exception_ptr error;   ///< First exception raised in a callback (or Ctrl-C)
+};
+
+/**
+ * @brief Solves an instance, or a subset of its cities, with the GIL released
+ * @return Tuple (tour as an int32 NumPy array starting at the first city, length)
+ */
+static py::tuple solve(const PyInstance& instance, int iterations, int restarts,
+                       unsigned seed, int threads, const std::string& vnd,
+                       const std::string& engine, int neighbors, bool quantize,
+                       py::object progress, py::object cancel,
+                       std::optional<std::vector<int>> cities) {
+    if (iterations < 0 || restarts < 1) {
+        throw std::invalid_argument("iterations must not be negative "
+                                    "and restarts must be at least 1");
+    }
+    if (threads < 0) throw std::invalid_argument("threads must not be negative");
+
+    SearchOptions options;
+    if (!vnd.empty()) {
+        options.chain.clear();
+        for (const std::string& op : splitList(vnd)) {
+            options.chain.push_back(parseOperatorName(op));
+        }
+        if (options.chain.empty()) throw std::invalid_argument("vnd needs at least one operator");
+    }
+    if (!engine.empty()) options.engine = parseEngineName(engine);
+    options.threads = threads;
+    if (neighbors > 0) options.neighborListSize = neighbors;
+    options.quantize = quantize;
+
+    auto state = std::make_shared<CallbackState>();
+    state->progress = std::move(progress);
+    state->cancel = std::move(cancel);
+    if (!state->progress.is_none()) {
+        options.progress = [state](const SearchProgress& progress) {
+            py::gil_scoped_acquire acquire;
+            if (state->error) return;
+            try {
+                state->progress(progress.restartsDone, progress.restartsTotal, progress.best);
+            } catch (...) {
+                state->error = std::current_exception();
+            }
+        };
+    }
+    // Always polled, so that Ctrl-C interrupts a long solve
+    options.cancel = [state]() {
+        py::gil_scoped_acquire acquire;
+        if (state->error) return true;
+        try {
+            if (PyErr_CheckSignals() != 0) throw py::error_already_set();
+            return !state->cancel.is_none() && state->cancel().cast<bool>();
+        } catch (...) {
+            state->error = std::current_exception();
+            return true;
+        }
+    };
+
+    std::vector<int> best;
+    double length = 0.0;
+    {
+        py::gil_scoped_release release;
+        TSPSolver solver(instance.instance, seed);
+        solver.configureSearch(options);
+        best = cities ? solver.solveSubset(*cities, iterations, restarts, false)
+                      : solver.solveTSP(iterations, restarts);
+        length = solver.calculateTourLength(best);
+    }
+    if (state->error) std::rethrow_exception(state->error);
+
+    // Hand the vector's buffer to NumPy instead of copying it
+    auto* tour = new std::vector<int>(std::move(best));
+    py::capsule owner(tour, [](void* p) { delete static_cast<std::vector<int>*>(p); });
+    py::array_t<int> array(static_cast<py::ssize_t>(tour->size()), tour->data(), owner);
+    return py::make_tuple(array, length);
+}
+
+PYBIND11_MODULE(tsp, m) {
+    m.doc() = "Parallel TSP solver (shotgun hill climbing with VND local search)";
+
+    py::class_<PyInstance>(m, "Instance")
+        .def(py::init(&makeInstance), py::arg("matrix"),
+             "Wraps a square float64 / float32 / int32 distance matrix "
+             "(used without copying and must not be modified)")
+        .def("__len__", [](const PyInstance& self) { return self.instance->size(); })
+        .def_property_readonly("size", [](const PyInstance& self) {
+            return self.instance->size();
+        });
+
+    m.def("solve", &solve, py::arg("instance"),
+          py::arg("iterations") = 1000, py::arg("restarts") = 10, py::arg("seed") = 42u,
+          py::arg("threads") = 0, py::arg("vnd") = "", py::arg("engine") = "",
+          py::arg("neighbors") = 0, py::arg("quantize") = false,
+          py::arg("progress") = py::none(), py::arg("cancel") = py::none(),
+          py::arg("cities") = py::none(),
+          "Solves the instance (or the listed cities of it) and returns (tour, length).\n"
+          "progress(done, total, best) runs after every restart; cancel() returning\n"
+          "True stops the search and the best tour so far is returned.");
+}
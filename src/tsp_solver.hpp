@@ -0,0 +1,5438 @@
+/**
+ * @file tsp_solver.hpp
+ * @brief Parallel TSP solver (shotgun hill climbing with VND local search), header-only
+ *
+ * Shared by the command line program (main_tsp_p.cpp) and the C library
+ * (libtsp.cpp). Build with -fopenmp -std=c++17.
+ */
+#ifndef TSP_SOLVER_HPP
+#define TSP_SOLVER_HPP
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <numeric>
+#include <stdexcept>
+#include <memory>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <cerrno>
+#include <list>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <omp.h>  // OpenMP for parallelization
+#ifdef TSP_HAVE_ZLIB
+#include <zlib.h>  // gzip input (CompressedInput)
+#endif
+#ifdef TSP_HAVE_ZSTD
+#include <zstd.h>  // zstd input (CompressedInput)
+#endif
+
+/**
+ * @enum MoveOperator
+ * @brief Local search neighbourhoods that can be chained by the VND driver
+ */
+enum class MoveOperator {
+    TwoOpt,       ///< Segment reversal (classic 2-opt)
+    OrOpt,        ///< Move a segment of 1-3 cities to another position
+    Swap,             ///< Exchange the positions of two cities
+    LinKernighan,     ///< Depth-limited chain of 2-opt moves (LK-style)
+    SegmentInsertion, ///< Or-3opt: move a segment next to a near neighbour, optionally reversed
+    TwoOptNeighbors,  ///< 2-opt restricted to candidate-list edges (no full O(n^2) scan)
+    BalasSimonetti    ///< Best reordering within a sliding window of k positions (DP)
+};
+
+/**
+ * @brief Returns the command line name of a move operator
+ */
+inline const char* operatorName(MoveOperator op) {
+    switch (op) {
+        case MoveOperator::TwoOpt: return "2opt";
+        case MoveOperator::OrOpt: return "oropt";
+        case MoveOperator::Swap: return "swap";
+        case MoveOperator::LinKernighan: return "lk";
+        case MoveOperator::SegmentInsertion: return "or3opt";
+        case MoveOperator::TwoOptNeighbors: return "2optnl";
+        case MoveOperator::BalasSimonetti: return "bs";
+    }
+    return "?";
+}
+
+/**
+ * @brief Parses an operator name as accepted by --vnd
+ * @throws std::runtime_error if the name is unknown
+ */
+inline MoveOperator parseOperatorName(const std::string& name) {
+    for (MoveOperator op : {MoveOperator::TwoOpt, MoveOperator::OrOpt,
+                            MoveOperator::Swap, MoveOperator::LinKernighan,
+                            MoveOperator::SegmentInsertion, MoveOperator::TwoOptNeighbors,
+                            MoveOperator::BalasSimonetti}) {
+        if (name == operatorName(op)) return op;
+    }
+    throw std::runtime_error("Unknown local search operator: " + name);
+}
+
+/**
+ * @brief Splits a comma-separated list such as an operator chain
+ */
+inline std::vector<std::string> splitList(const std::string& value) {
+    std::vector<std::string> items;
+    std::stringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+/**
+ * @struct OperatorStats
+ * @brief Counters collected per operator so the chain can be ordered by cost-effectiveness
+ */
+struct OperatorStats {
+    long long calls = 0;        ///< Times the operator was invoked by the VND driver
+    long long evaluations = 0;  ///< Candidate moves evaluated
+    long long improvements = 0; ///< Improving moves applied
+    double gain = 0.0;          ///< Total tour length removed by this operator
+    double seconds = 0.0;       ///< Wall time spent inside the operator
+    long long verifications = 0; ///< Candidates that passed the quantized prescreen
+
+    OperatorStats& operator+=(const OperatorStats& other) {
+        calls += other.calls;
+        evaluations += other.evaluations;
+        improvements += other.improvements;
+        gain += other.gain;
+        seconds += other.seconds;
+        verifications += other.verifications;
+        return *this;
+    }
+};
+
+/**
+ * @enum InitStrategy
+ * @brief How each restart builds its starting tour
+ */
+enum class InitStrategy {
+    Random,  ///< Uniform random permutation
+    Diverse  ///< Perturbed greedy tour steered away from edges already explored
+};
+
+/**
+ * @class EdgeUsageBitmap
+ * @brief Thread-safe record of the (undirected) edges used by tours already explored
+ *
+ * One bit per unordered city pair, packed as the strict upper triangle, so
+ * n = 10 000 costs 6.25 MB. Bits are only ever set, which lets threads share the
+ * bitmap with relaxed atomic operations.
+ */
+class EdgeUsageBitmap {
+public:
+    explicit EdgeUsageBitmap(size_t n)
+        : n_(n), words_(wordCount(n)) {}
+
+    /**
+     * @brief Memory taken by the bitmap of an n-city instance
+     */
+    static size_t bytes(size_t n) { return wordCount(n) * sizeof(uint64_t); }
+
+    /**
+     * @brief Whether edge {a, b} appears in any recorded tour
+     */
+    bool test(int a, int b) const {
+        size_t bit = index(a, b);
+        return (words_[bit / 64].load(std::memory_order_relaxed) >> (bit % 64)) & 1;
+    }
+
+    /**
+     * @brief Records every edge of a closed tour
+     */
+    void mark(const std::vector<int>& tour) {
+        if (tour.size() < 2) return; // A one-city tour has no edge, only a self-loop
+        for (size_t k = 0; k < tour.size(); ++k) {
+            size_t bit = index(tour[k], tour[(k + 1) % tour.size()]);
+            words_[bit / 64].fetch_or(uint64_t{1} << (bit % 64), std::memory_order_relaxed);
+        }
+    }
+
+private:
+    size_t n_;
+    std::vector<std::atomic<uint64_t>> words_;
+
+    static size_t wordCount(size_t n) { return (n * (n - 1) / 2 + 63) / 64; }
+
+    /**
+     * @brief Bit of pair {a, b} (a != b): row a of the upper triangle holds b = a + 1 .. n - 1
+     */
+    size_t index(int a, int b) const {
+        size_t lo = static_cast<size_t>(std::min(a, b));
+        size_t hi = static_cast<size_t>(std::max(a, b));
+        return lo * (2 * n_ - lo - 1) / 2 + (hi - lo - 1);
+    }
+};
+
+/**
+ * @enum Engine
+ * @brief Top-level solution strategy
+ */
+enum class Engine {
+    Auto,             ///< Let the planner choose from the instance size and machine
+    Exact,            ///< Held-Karp dynamic programming (tiny instances only)
+    Sequential,       ///< Restarts on a single thread, no fork/join overhead
+    ParallelRestarts, ///< Restarts distributed across threads (shotgun)
+    IntraRestart,     ///< Restarts one after another, each 2-opt scan split across threads
+    Nested,           ///< Restarts as tasks, large scans split into stealable sub-tasks
+    Interleaved,      ///< Each thread interleaves several 2-opt descents to overlap cache misses
+    Lanes,            ///< Small instances: 8 restarts in lockstep across SIMD lanes
+    Lns               ///< One tour improved by parallel destroy/repair attempts (restarts = rounds)
+};
+
+/**
+ * @brief Returns the command line name of an engine
+ */
+inline const char* engineName(Engine engine) {
+    switch (engine) {
+        case Engine::Auto: return "auto";
+        case Engine::Exact: return "exact";
+        case Engine::Sequential: return "sequential";
+        case Engine::ParallelRestarts: return "restarts";
+        case Engine::IntraRestart: return "intra";
+        case Engine::Nested: return "nested";
+        case Engine::Interleaved: return "interleaved";
+        case Engine::Lanes: return "simd";
+        case Engine::Lns: return "lns";
+    }
+    return "?";
+}
+
+/**
+ * @brief Parses an engine name as accepted by --engine
+ * @throws std::runtime_error if the name is unknown
+ */
+inline Engine parseEngineName(const std::string& name) {
+    for (Engine engine : {Engine::Auto, Engine::Exact, Engine::Sequential,
+                          Engine::ParallelRestarts, Engine::IntraRestart,
+                          Engine::Nested, Engine::Interleaved, Engine::Lanes, Engine::Lns}) {
+        if (name == engineName(engine)) return engine;
+    }
+    throw std::runtime_error("Unknown engine: " + name);
+}
+
+/**
+ * @struct ExecutionPlan
+ * @brief Engine and thread count chosen for one solve
+ */
+struct ExecutionPlan {
+    Engine engine = Engine::ParallelRestarts;
+    int threads = 1;
+    double estimatedSeconds = 0.0; ///< Planner's cost model prediction (0 if not planned)
+};
+
+/**
+ * @struct Calibration
+ * @brief Machine constants measured by the planner's micro-benchmark
+ */
+struct Calibration {
+    double forkJoinSeconds = 0.0; ///< Cost of entering and leaving one parallel region
+    double evalSeconds = 0.0;     ///< Cost of one 2-opt move evaluation on this instance
+};
+
+/**
+ * @class RowCache
+ * @brief Small cache of matrix rows copied out of a mapped file or a view, or computed
+ *        from coordinates (one per thread)
+ *
+ * A returned row pointer stays valid until capacity - 1 other rows have been
+ * fetched, so the capacity is kept well above the handful of rows a single move
+ * evaluation reads. Full rows are evicted in LRU or CLOCK order; CLOCK finds
+ * rows through a direct slot table and only sets a bit on a hit, where LRU
+ * moves a list node. When every row fits, rows are never evicted.
+ */
+class RowCache {
+public:
+    static constexpr size_t kMinRows = 16;
+
+    /// Eviction order once the cache is full
+    enum class Policy { Lru, Clock };
+
+    RowCache(size_t rows, size_t n, Policy policy = Policy::Lru)
+        : n_(n), capacity_(std::max(rows, kMinRows)), storage_(std::min(capacity_, n) * n) {
+        if (capacity_ >= n || policy == Policy::Clock) {
+            size_t slots = std::min(capacity_, n);
+            slotOf_.assign(n, -1);
+            rowOfSlot_.assign(slots, 0);
+            referenced_.assign(slots, 0);
+        }
+    }
+
+    /**
+     * @brief Returns row a, copying it from source on a miss
+     * @param a Row index
+     * @param source Values to copy
+     * @param columns If set, entry b is copied from source[columns[b]] (view gather)
+     */
+    const double* get(size_t a, const double* source, const int* columns = nullptr) {
+        return get(a, [this, source, columns](double* out) {
+            if (columns) {
+                for (size_t b = 0; b < n_; ++b) out[b] = source[columns[b]];
+            } else {
+                std::copy(source, source + n_, out);
+            }
+        });
+    }
+
+    /**
+     * @brief Returns row a, letting fill write it on a miss
+     * @param a Row index
+     * @param fill Callable writing the n entries of row a to its double* argument
+     */
+    template <typename Fill>
+    const double* get(size_t a, Fill&& fill) {
+        if (!slotOf_.empty()) {
+            int slot = slotOf_[a];
+            if (slot >= 0) {
+                ++hits_;
+                referenced_[slot] = 1;
+                return slotData(slot);
+            }
+            ++misses_;
+            size_t victim = used_ < rowOfSlot_.size() ? used_++ : clockVictim();
+            slotOf_[a] = static_cast<int>(victim);
+            rowOfSlot_[victim] = a;
+            referenced_[victim] = 1;
+            fill(slotData(victim));
+            return slotData(victim);
+        }
+
+        auto it = index_.find(a);
+        if (it != index_.end()) {
+            ++hits_;
+            lru_.splice(lru_.begin(), lru_, it->second);
+            return slotData(it->second->second);
+        }
+
+        ++misses_;
+        size_t slot;
+        if (lru_.size() < capacity_) {
+            slot = lru_.size();
+        } else {
+            slot = lru_.back().second; // Evict the least recently used row
+            index_.erase(lru_.back().first);
+            lru_.pop_back();
+        }
+        lru_.emplace_front(a, slot);
+        index_[a] = lru_.begin();
+        fill(slotData(slot));
+        return slotData(slot);
+    }
+
+    long long hits() const { return hits_; }
+    long long misses() const { return misses_; }
+
+private:
+    size_t n_;
+    size_t capacity_;
+    std::vector<double> storage_;
+    std::list<std::pair<size_t, size_t>> lru_; ///< (row, slot), most recent first
+    std::unordered_map<size_t, std::list<std::pair<size_t, size_t>>::iterator> index_;
+    std::vector<int> slotOf_;         ///< Direct/CLOCK: slot of each row (-1: not loaded)
+    std::vector<size_t> rowOfSlot_;   ///< Direct/CLOCK: row held by each slot
+    std::vector<uint8_t> referenced_; ///< CLOCK: slot read since the hand last passed
+    size_t used_ = 0;                 ///< Direct/CLOCK: slots handed out so far
+    size_t hand_ = 0;                 ///< CLOCK: next slot considered for eviction
+    long long hits_ = 0;
+    long long misses_ = 0;
+
+    double* slotData(size_t slot) { return storage_.data() + slot * n_; }
+
+    /**
+     * @brief Frees the first slot not read since the hand last passed it
+     */
+    size_t clockVictim() {
+        while (referenced_[hand_]) {
+            referenced_[hand_] = 0;
+            hand_ = (hand_ + 1) % rowOfSlot_.size();
+        }
+        size_t victim = hand_;
+        hand_ = (hand_ + 1) % rowOfSlot_.size();
+        slotOf_[rowOfSlot_[victim]] = -1;
+        return victim;
+    }
+};
+
+/**
+ * @struct TSPLIBHeader
+ * @brief Specification part of a TSPLIB file, read up to the start of its data section
+ */
+struct TSPLIBHeader {
+    size_t dimension = 0;                  ///< Number of cities
+    std::string edgeWeightType = "EUC_2D"; ///< Metric, or EXPLICIT for listed weights
+    std::string edgeWeightFormat;          ///< Layout of an EXPLICIT EDGE_WEIGHT_SECTION
+    std::string section;                   ///< NODE_COORD_SECTION or EDGE_WEIGHT_SECTION
+
+    /**
+     * @brief Reads keywords until the first data section
+     * @throws std::runtime_error on unsupported or malformed files
+     */
+    static TSPLIBHeader read(std::istream& in) {
+        TSPLIBHeader header;
+        std::string line;
+        while (header.section.empty() && std::getline(in, line)) {
+            size_t colon = line.find(':');
+            std::string key = trim(line.substr(0, colon));
+            std::string value = colon == std::string::npos ? "" : trim(line.substr(colon + 1));
+            if (key == "DIMENSION") {
+                header.dimension = std::stoul(value);
+            } else if (key == "EDGE_WEIGHT_TYPE") {
+                header.edgeWeightType = value;
+            } else if (key == "EDGE_WEIGHT_FORMAT") {
+                header.edgeWeightFormat = value;
+            } else if (key == "TYPE" && value != "TSP") {
+                throw std::runtime_error("Unsupported TSPLIB TYPE: " + value);
+            } else if (key == "NODE_COORD_SECTION" || key == "EDGE_WEIGHT_SECTION") {
+                header.section = key;
+            }
+        }
+        if (header.section.empty() || header.dimension == 0) {
+            throw std::runtime_error("TSPLIB file needs DIMENSION and a NODE_COORD_SECTION "
+                                     "or EDGE_WEIGHT_SECTION");
+        }
+        return header;
+    }
+
+private:
+    static std::string trim(const std::string& text) {
+        size_t first = text.find_first_not_of(" \t\r");
+        if (first == std::string::npos) return "";
+        return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+    }
+};
+
+/**
+ * @class Coordinates
+ * @brief City coordinates of a TSPLIB instance and its distance function
+ *
+ * Distances follow the TSPLIB definitions (integer-valued, same rounding), so tour
+ * lengths compare directly with published results. x and y are kept as separate
+ * arrays, so a whole distance row is one loop the compiler vectorizes; for GEO
+ * they hold latitude and longitude in radians, converted once at load.
+ *
+ * GEO pairs use per-city sine and cosine tables: the TSPLIB formula is the
+ * spherical law of cosines, so cos(angle) = sin(latA) sin(latB) +
+ * cos(latA) cos(latB) cos(lonA - lonB) needs no trigonometry per pair. The acos
+ * is a branch-free series (seriesAcos), so the whole row vectorizes. A result
+ * that lands within kGeoTolerance of an integer is recomputed with the reference
+ * formula, so the truncated distance is always exactly TSPLIB's.
+ *
+ * Build with -fno-math-errno -march=native so the row loops vectorize; otherwise
+ * every sqrt keeps a branch to the errno-setting library call.
+ */
+class Coordinates {
+public:
+    /// TSPLIB EDGE_WEIGHT_TYPE
+    enum class Metric { Euclidean, Ceiling, Att, Geo };
+
+    /**
+     * @brief Coordinates in the units of the metric
+     * @throws std::runtime_error if the arrays are empty or differ in length
+     */
+    Coordinates(Metric metric, std::vector<double> x, std::vector<double> y)
+        : metric_(metric), x_(std::move(x)), y_(std::move(y)) {
+        if (x_.empty() || x_.size() != y_.size()) {
+            throw std::runtime_error("Invalid coordinates");
+        }
+        if (metric_ == Metric::Geo) {
+            size_t n = x_.size();
+            sinLat_.resize(n);
+            cosLat_.resize(n);
+            sinLon_.resize(n);
+            cosLon_.resize(n);
+            for (size_t k = 0; k < n; ++k) {
+                sinLat_[k] = std::sin(x_[k]);
+                cosLat_[k] = std::cos(x_[k]);
+                sinLon_[k] = std::sin(y_[k]);
+                cosLon_[k] = std::cos(y_[k]);
+            }
+        }
+    }
+
+    /**
+     * @brief Reads a TSPLIB file with a NODE_COORD_SECTION
+     * @param in File contents (EUC_2D, CEIL_2D, ATT or GEO)
+     * @throws std::runtime_error on unsupported or malformed files
+     */
+    static Coordinates fromTSPLIB(std::istream& in) {
+        return fromTSPLIB(TSPLIBHeader::read(in), in);
+    }
+
+    /**
+     * @brief Reads the NODE_COORD_SECTION that follows an already parsed header
+     * @throws std::runtime_error on unsupported or malformed files
+     */
+    static Coordinates fromTSPLIB(const TSPLIBHeader& header, std::istream& in) {
+        const std::string& type = header.edgeWeightType;
+        if (header.section != "NODE_COORD_SECTION") {
+            throw std::runtime_error("EDGE_WEIGHT_TYPE " + type + " needs a NODE_COORD_SECTION");
+        }
+        Metric metric;
+        if (type == "EUC_2D") metric = Metric::Euclidean;
+        else if (type == "CEIL_2D") metric = Metric::Ceiling;
+        else if (type == "ATT") metric = Metric::Att;
+        else if (type == "GEO") metric = Metric::Geo;
+        else throw std::runtime_error("Unsupported EDGE_WEIGHT_TYPE: " + type);
+
+        size_t n = header.dimension;
+        std::vector<double> x(n), y(n);
+        for (size_t k = 0; k < n; ++k) {
+            long long id;
+            if (!(in >> id >> x[k] >> y[k])) {
+                throw std::runtime_error("Truncated NODE_COORD_SECTION");
+            }
+            // City k of the solver is TSPLIB node k + 1
+            if (id != static_cast<long long>(k + 1)) {
+                throw std::runtime_error("TSPLIB nodes must be numbered 1..n in order, got " +
+                                         std::to_string(id));
+            }
+        }
+        if (metric == Metric::Geo) {
+            for (size_t k = 0; k < n; ++k) {
+                x[k] = geoRadians(x[k]);
+                y[k] = geoRadians(y[k]);
+            }
+        }
+        return Coordinates(metric, std::move(x), std::move(y));
+    }
+
+    size_t size() const { return x_.size(); }
+    Metric metric() const { return metric_; }
+
+    /**
+     * @brief Distance between cities a and b
+     */
+    double distance(size_t a, size_t b) const {
+        switch (metric_) {
+            case Metric::Euclidean: return distance<Metric::Euclidean>(a, b);
+            case Metric::Ceiling:   return distance<Metric::Ceiling>(a, b);
+            case Metric::Att:       return distance<Metric::Att>(a, b);
+            case Metric::Geo:       return distance<Metric::Geo>(a, b);
+        }
+        return 0.0;
+    }
+
+    /**
+     * @brief Distance between cities a and b under a metric fixed at compile time
+     *
+     * M must be metric(); CoordinateDistance<M> inlines this into the search loops.
+     */
+    template <Metric M>
+    double distance(size_t a, size_t b) const {
+        if (a == b) return 0.0;
+        if constexpr (M == Metric::Euclidean) {
+            return euclidean(x_[a] - x_[b], y_[a] - y_[b]);
+        } else if constexpr (M == Metric::Ceiling) {
+            return ceiling(x_[a] - x_[b], y_[a] - y_[b]);
+        } else if constexpr (M == Metric::Att) {
+            return att(x_[a] - x_[b], y_[a] - y_[b]);
+        } else {
+            return geoTruncate(a, b, geoKilometres(a, b));
+        }
+    }
+
+    /**
+     * @brief Writes the distances from city a to every city
+     * @param a Row index
+     * @param out n entries
+     */
+    void row(size_t a, double* out) const {
+        size_t n = size();
+        const double* x = x_.data();
+        const double* y = y_.data();
+        double xa = x[a], ya = y[a];
+        switch (metric_) {
+            case Metric::Euclidean:
+                #pragma omp simd
+                for (size_t b = 0; b < n; ++b) out[b] = euclidean(xa - x[b], ya - y[b]);
+                break;
+            case Metric::Ceiling:
+                #pragma omp simd
+                for (size_t b = 0; b < n; ++b) out[b] = ceiling(xa - x[b], ya - y[b]);
+                break;
+            case Metric::Att:
+                #pragma omp simd
+                for (size_t b = 0; b < n; ++b) out[b] = att(xa - x[b], ya - y[b]);
+                break;
+            case Metric::Geo: {
+                const double* sinLat = sinLat_.data();
+                const double* cosLat = cosLat_.data();
+                const double* sinLon = sinLon_.data();
+                const double* cosLon = cosLon_.data();
+                double sinA = sinLat[a], cosA = cosLat[a];
+                double sinLonA = sinLon[a], cosLonA = cosLon[a];
+                #pragma omp simd
+                for (size_t b = 0; b < n; ++b) {
+                    double cosLonDiff = cosLonA * cosLon[b] + sinLonA * sinLon[b];
+                    double cosAngle = sinA * sinLat[b] + cosA * cosLat[b] * cosLonDiff;
+                    out[b] = kGeoRadius * seriesAcos(clampCosine(cosAngle)) + 1.0;
+                }
+                for (size_t b = 0; b < n; ++b) out[b] = geoTruncate(a, b, out[b]);
+                break;
+            }
+        }
+        out[a] = 0.0;
+    }
+
+private:
+    static constexpr double kGeoRadius = 6378.388; ///< TSPLIB earth radius in km
+    static constexpr double kGeoTolerance = 1e-3;  ///< Km; far above the fast formula's error
+
+    Metric metric_;
+    std::vector<double> x_; ///< x, or latitude in radians (GEO)
+    std::vector<double> y_; ///< y, or longitude in radians (GEO)
+    std::vector<double> sinLat_, cosLat_; ///< GEO: per-city latitude terms
+    std::vector<double> sinLon_, cosLon_; ///< GEO: per-city longitude terms
+
+    /// TSPLIB nint: round half up, then truncate to an integer
+    static double nint(double value) { return static_cast<double>(static_cast<int>(value + 0.5)); }
+
+    static double euclidean(double dx, double dy) { return nint(std::sqrt(dx * dx + dy * dy)); }
+
+    /// Rounds up like std::ceil, written as att's truncate-and-adjust so the row loop vectorizes
+    static double ceiling(double dx, double dy) {
+        double r = std::sqrt(dx * dx + dy * dy);
+        double t = static_cast<double>(static_cast<int>(r));
+        return t < r ? t + 1.0 : t;
+    }
+
+    /// Pseudo-Euclidean distance of the att instances
+    static double att(double dx, double dy) {
+        double r = std::sqrt((dx * dx + dy * dy) / 10.0);
+        double t = nint(r);
+        return t < r ? t + 1.0 : t;
+    }
+
+    /**
+     * @brief TSPLIB DDD.MM (degrees, minutes) to radians
+     *
+     * The degrees are truncated, as in the reference implementation the published
+     * optima were computed with (the TSPLIB text says nint).
+     */
+    static double geoRadians(double value) {
+        const double pi = 3.141592; // TSPLIB's constant, not M_PI
+        double degrees = static_cast<double>(static_cast<int>(value));
+        double minutes = value - degrees;
+        return pi * (degrees + 5.0 * minutes / 3.0) / 180.0;
+    }
+
+    /// TSPLIB reference: great-circle distance on its idealized sphere, truncated after adding 1 km
+    static double geo(double latA, double lonA, double latB, double lonB) {
+        double q1 = std::cos(lonA - lonB);
+        double q2 = std::cos(latA - latB);
+        double q3 = std::cos(latA + latB);
+        return static_cast<double>(static_cast<int>(
+            kGeoRadius * std::acos(0.5 * ((1.0 + q1) * q2 - (1.0 - q1) * q3)) + 1.0));
+    }
+
+    /// Selects rather than std::min / std::max, whose reference arguments block vectorization
+    static double clampCosine(double value) {
+        return value > 1.0 ? 1.0 : value < -1.0 ? -1.0 : value;
+    }
+
+    /// Taylor coefficients of asin(z) / z in powers of z^2: (2k)! / (4^k (k!)^2 (2k + 1))
+    static constexpr int kAsinTerms = 18;
+    static constexpr std::array<double, kAsinTerms> asinSeries() {
+        std::array<double, kAsinTerms> series{};
+        double central = 1.0; // (2k)! / (4^k (k!)^2)
+        for (int k = 0; k < kAsinTerms; ++k) {
+            if (k > 0) central *= (2.0 * k - 1.0) / (2.0 * k);
+            series[k] = central / (2.0 * k + 1.0);
+        }
+        return series;
+    }
+
+    /**
+     * @brief acos without calls or branches, so loops over it vectorize
+     *
+     * asin(z) for |z| <= 1/2 by its series (error below 1e-13), with
+     * acos(x) = pi/2 - asin(x) for |x| <= 1/2 and 2 asin(sqrt((1 - x) / 2)) above.
+     */
+    static double seriesAcos(double x) {
+        constexpr std::array<double, kAsinTerms> series = asinSeries();
+        constexpr double pi = 3.14159265358979323846;
+        double ax = std::fabs(x);
+        bool inner = ax <= 0.5;
+        double outer = 0.5 * (1.0 - ax);
+        double z2 = inner ? ax * ax : outer;
+        double z = inner ? ax : std::sqrt(outer);
+        double p = series[kAsinTerms - 1];
+        #pragma GCC unroll 32
+        for (int k = kAsinTerms - 2; k >= 0; --k) p = p * z2 + series[k];
+        double acosAbs = inner ? 0.5 * pi - z * p : 2.0 * z * p;
+        return x < 0.0 ? pi - acosAbs : acosAbs;
+    }
+
+    /// GEO distance before truncation, from the precomputed tables
+    double geoKilometres(size_t a, size_t b) const {
+        double cosLonDiff = cosLon_[a] * cosLon_[b] + sinLon_[a] * sinLon_[b];
+        double cosAngle = sinLat_[a] * sinLat_[b] + cosLat_[a] * cosLat_[b] * cosLonDiff;
+        return kGeoRadius * seriesAcos(clampCosine(cosAngle)) + 1.0;
+    }
+
+    /**
+     * @brief TSPLIB GEO distance from its untruncated value
+     *
+     * Falls back to the reference formula when truncation could go either way.
+     */
+    double geoTruncate(size_t a, size_t b, double value) const {
+        double truncated = static_cast<double>(static_cast<int>(value));
+        if (value - truncated < kGeoTolerance || truncated + 1.0 - value < kGeoTolerance) {
+            return geo(x_[a], y_[a], x_[b], y_[b]);
+        }
+        return truncated;
+    }
+};
+
+/**
+ * @struct MatrixFileHeader
+ * @brief Header of the binary matrix format written by --convert and read by --matrix
+ *
+ * 64 bytes, followed by n * n little-endian doubles in row-major order, so every
+ * row starts on a cache line boundary of a page-aligned mapping.
+ */
+struct MatrixFileHeader {
+    char magic[8];           ///< "TSPMAT01"
+    uint64_t n;              ///< Number of cities
+    uint64_t reserved[6];    ///< Zero
+};
+
+/**
+ * @class DistanceMatrix
+ * @brief Contiguous row-major n x n distance matrix, owned in memory or mapped from disk
+ *
+ * matrix[a] returns a pointer to row a, so matrix[a][b] reads like the nested
+ * vectors it replaces, with one allocation instead of n. A mapped matrix lives in
+ * the page cache and can be larger than RAM; the search then only pays for the
+ * rows it actually touches.
+ *
+ * A view (see view) reads a subset of a master matrix's cities through an index
+ * map. Rows are still handed out as plain pointers, which keeps the dense hot
+ * path free of index translation: a view gathers each row it reads into the
+ * calling thread's row cache on first use, so only touched rows are ever copied.
+ * A coordinate matrix (see fromCoordinates) stores no distances at all and
+ * computes each row into the row cache the same way, and a triangular matrix
+ * (see fromTriangle) stores half of a symmetric matrix and unfolds rows into it.
+ * A borrowed float32 or int32 matrix (see borrow) is read in place and converts
+ * rows into the row cache.
+ */
+class DistanceMatrix {
+public:
+    /// Access pattern hints forwarded to madvise for mapped matrices
+    enum class Access { Normal, Sequential, Random };
+
+    /// Element type of the stored entries (only borrowed matrices hold other than doubles)
+    enum class Element { Float64, Float32, Int32 };
+
+    static constexpr char kMagic[8] = {'T', 'S', 'P', 'M', 'A', 'T', '0', '1'};
+
+    DistanceMatrix() = default;
+
+    /**
+     * @brief Owned matrix from row-major values
+     * @param n Number of cities
+     * @param values n * n entries
+     */
+    DistanceMatrix(size_t n, std::vector<double> values)
+        : n_(n), stride_(n), owned_(std::move(values)), data_(owned_.data()) {}
+
+    /**
+     * @brief Owned zero matrix, filled through mutableRow
+     */
+    explicit DistanceMatrix(size_t n)
+        : DistanceMatrix(n, std::vector<double>(n * n, 0.0)) {}
+
+    DistanceMatrix(DistanceMatrix&& other) noexcept { *this = std::move(other); }
+
+    DistanceMatrix& operator=(DistanceMatrix&& other) noexcept {
+        if (this != &other) {
+            unmap();
+            n_ = other.n_;
+            stride_ = other.stride_;
+            owned_ = std::move(other.owned_);
+            data_ = other.data_;
+            mapping_ = other.mapping_;
+            mappingBytes_ = other.mappingBytes_;
+            caches_ = std::move(other.caches_);
+            rowCacheRows_ = other.rowCacheRows_;
+            rowCachePolicy_ = other.rowCachePolicy_;
+            coordinates_ = std::move(other.coordinates_);
+            triangle_ = std::move(other.triangle_);
+            typed_ = other.typed_;
+            element_ = other.element_;
+            other.typed_ = nullptr;
+            other.element_ = Element::Float64;
+            rowCached_ = other.rowCached_;
+            cacheId_ = other.cacheId_;
+            other.cacheId_ = nextCacheId();
+            other.rowCached_ = false;
+            master_ = other.master_;
+            cities_ = std::move(other.cities_);
+            other.master_ = nullptr;
+            other.n_ = 0;
+            other.data_ = nullptr;
+            other.mapping_ = nullptr;
+            other.mappingBytes_ = 0;
+        }
+        return *this;
+    }
+
+    ~DistanceMatrix() { unmap(); }
+
+    /**
+     * @brief Owned copy of nested rows
+     * @throws std::runtime_error if the rows are empty or do not form a square matrix
+     */
+    static DistanceMatrix fromRows(const std::vector<std::vector<double>>& rows) {
+        size_t n = rows.size();
+        if (n == 0 || std::any_of(rows.begin(), rows.end(),
+                                  [n](const auto& row) { return row.size() != n; })) {
+            throw std::runtime_error("Invalid adjacency matrix");
+        }
+        DistanceMatrix matrix(n);
+        for (size_t a = 0; a < n; ++a) {
+            std::copy(rows[a].begin(), rows[a].end(), matrix.mutableRow(a));
+        }
+        return matrix;
+    }
+
+    /**
+     * @brief Maps a binary matrix file read-only
+     * @param path File written by --convert
+     * @param rowCacheRows Rows cached per thread (0 reads the mapping directly)
+     * @param policy Row cache eviction order
+     * @throws std::runtime_error if the file cannot be mapped or is malformed
+     */
+    static DistanceMatrix mapFile(const std::string& path, size_t rowCacheRows,
+                                  RowCache::Policy policy = RowCache::Policy::Lru) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+        }
+        return mapDescriptor(fd, path, rowCacheRows, policy);
+    }
+
+    /**
+     * @brief Attaches read-only to a matrix published by another process
+     * @param name POSIX shared-memory name, e.g. "/tsp-master"
+     * @param rowCacheRows Rows cached per thread (0 reads the segment directly)
+     * @param policy Row cache eviction order
+     * @throws std::runtime_error if the segment does not exist or is incomplete
+     *
+     * The pages are shared with the publisher and every other attached process,
+     * so the host holds a single copy however many solvers run.
+     */
+    static DistanceMatrix attachShared(const std::string& name, size_t rowCacheRows,
+                                       RowCache::Policy policy = RowCache::Policy::Lru) {
+        int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot attach shared matrix " + name + ": " +
+                                     std::strerror(errno));
+        }
+        return mapDescriptor(fd, name, rowCacheRows, policy);
+    }
+
+    /**
+     * @brief Copies the matrix into a new named shared-memory segment
+     * @param name POSIX shared-memory name; must not exist yet
+     * @throws std::runtime_error if the segment cannot be created
+     *
+     * The segment uses the binary file layout and outlives this process until
+     * unpublish is called. The magic is written last, so a process attaching
+     * while the copy is still running sees an invalid segment instead of a
+     * half-filled matrix.
+     */
+    void publish(const std::string& name) const {
+        int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot create shared matrix " + name + ": " +
+                                     std::strerror(errno));
+        }
+        size_t bytes = sizeof(MatrixFileHeader) + n_ * n_ * sizeof(double);
+        void* mapping = ::ftruncate(fd, bytes) == 0
+            ? ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+            : MAP_FAILED;
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            ::shm_unlink(name.c_str());
+            throw std::runtime_error("Cannot map shared matrix " + name + ": " +
+                                     std::strerror(errno));
+        }
+
+        auto* header = static_cast<MatrixFileHeader*>(mapping);
+        header->n = n_;
+        double* values = reinterpret_cast<double*>(header + 1);
+        for (size_t a = 0; a < n_; ++a) {
+            const double* row = (*this)[a];
+            std::copy(row, row + n_, values + a * n_);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        std::copy(kMagic, kMagic + 8, header->magic);
+        ::munmap(mapping, bytes);
+    }
+
+    /**
+     * @brief Removes a published segment (attached processes keep their mapping)
+     * @throws std::runtime_error if the segment does not exist
+     */
+    static void unpublish(const std::string& name) {
+        if (::shm_unlink(name.c_str()) != 0) {
+            throw std::runtime_error("Cannot remove shared matrix " + name + ": " +
+                                     std::strerror(errno));
+        }
+    }
+
+    /**
+     * @brief Non-owning matrix over caller memory (zero copy)
+     * @param data Entry (0, 0) of a row-major matrix
+     * @param n Number of cities
+     * @param rowStride Distance between row starts, in doubles (at least n)
+     * @throws std::runtime_error if the arguments do not describe a matrix
+     *
+     * The caller keeps the memory alive and unchanged while the matrix is in use.
+     */
+    static DistanceMatrix borrow(const double* data, size_t n, size_t rowStride) {
+        if (!data || n == 0 || rowStride < n) {
+            throw std::runtime_error("Invalid borrowed matrix");
+        }
+        DistanceMatrix matrix;
+        matrix.n_ = n;
+        matrix.stride_ = rowStride;
+        matrix.data_ = data;
+        return matrix;
+    }
+
+    /**
+     * @brief Non-owning float32 matrix over caller memory (zero copy)
+     * @param rowCacheRows Rows cached per thread (0 sizes the cache to kDefaultCacheBytes)
+     * @param policy Row cache eviction order
+     *
+     * Same contract as the double overload. Entries are converted to double as
+     * they are read, and whole rows through the row cache.
+     */
+    static DistanceMatrix borrow(const float* data, size_t n, size_t rowStride,
+                                 size_t rowCacheRows = 0,
+                                 RowCache::Policy policy = RowCache::Policy::Lru) {
+        return borrowTyped(data, Element::Float32, n, rowStride, rowCacheRows, policy);
+    }
+
+    /**
+     * @brief Non-owning int32 matrix over caller memory (zero copy), see the float32 overload
+     */
+    static DistanceMatrix borrow(const int32_t* data, size_t n, size_t rowStride,
+                                 size_t rowCacheRows = 0,
+                                 RowCache::Policy policy = RowCache::Policy::Lru) {
+        return borrowTyped(data, Element::Int32, n, rowStride, rowCacheRows, policy);
+    }
+
+    /**
+     * @brief Non-owning view of a subset of a master matrix's cities
+     * @param master Matrix to read from; must outlive the view
+     * @param cities Master index of each local city (distinct, in range)
+     * @param rowCacheRows Rows cached per thread (0 caches every row that is read)
+     * @param policy Row cache eviction order
+     * @throws std::runtime_error if the city list is empty or invalid
+     *
+     * Local entry (a, b) is master entry (cities[a], cities[b]). Views of views
+     * resolve to the underlying master, so a row is a single gather.
+     */
+    static DistanceMatrix view(const DistanceMatrix& master, std::vector<int> cities,
+                               size_t rowCacheRows = 0,
+                               RowCache::Policy policy = RowCache::Policy::Lru) {
+        validateSubset(master.size(), cities);
+        if (master.master_) {
+            for (int& city : cities) city = master.cities_[city];
+        }
+        DistanceMatrix matrix;
+        matrix.master_ = master.master_ ? master.master_ : &master;
+        matrix.n_ = cities.size();
+        matrix.cities_ = std::move(cities);
+        matrix.rowCacheRows_ = rowCacheRows > 0 ? rowCacheRows : matrix.n_;
+        matrix.rowCachePolicy_ = policy;
+        matrix.rowCached_ = true;
+        return matrix;
+    }
+
+    /**
+     * @brief Matrix whose rows are computed from coordinates when first read
+     * @param coordinates Cities and metric
+     * @param rowCacheRows Rows cached per thread (0 sizes the cache to kDefaultCacheBytes)
+     * @param policy Row cache eviction order
+     *
+     * Memory is O(n) plus the per-thread caches instead of O(n^2). Each miss
+     * computes one row in a vectorized loop; hits cost the same as a stored matrix.
+     */
+    static DistanceMatrix fromCoordinates(std::shared_ptr<const Coordinates> coordinates,
+                                          size_t rowCacheRows = 0,
+                                          RowCache::Policy policy = RowCache::Policy::Lru) {
+        DistanceMatrix matrix;
+        matrix.n_ = coordinates->size();
+        matrix.coordinates_ = std::move(coordinates);
+        matrix.enableComputedRows(rowCacheRows, policy);
+        return matrix;
+    }
+
+    /**
+     * @brief Symmetric matrix stored as its packed lower triangle
+     * @param n Number of cities
+     * @param lower n (n + 1) / 2 entries: row a holds columns 0..a
+     * @param rowCacheRows Rows cached per thread (0 sizes the cache to kDefaultCacheBytes)
+     * @param policy Row cache eviction order
+     * @throws std::runtime_error if lower has the wrong size
+     *
+     * Half the memory of a dense matrix. Single entries are read in place; rows
+     * are unfolded into the row cache.
+     */
+    static DistanceMatrix fromTriangle(size_t n, std::vector<double> lower,
+                                       size_t rowCacheRows = 0,
+                                       RowCache::Policy policy = RowCache::Policy::Lru) {
+        if (n == 0 || lower.size() != n * (n + 1) / 2) {
+            throw std::runtime_error("Triangular matrix needs n (n + 1) / 2 entries");
+        }
+        DistanceMatrix matrix;
+        matrix.n_ = n;
+        matrix.triangle_ = std::move(lower);
+        matrix.enableComputedRows(rowCacheRows, policy);
+        return matrix;
+    }
+
+    /**
+     * @brief Reads a TSPLIB file: coordinates, or an EXPLICIT symmetric matrix
+     * @param in File contents
+     * @param rowCacheRows Rows cached per thread (0 sizes the cache to kDefaultCacheBytes)
+     * @param policy Row cache eviction order
+     * @throws std::runtime_error on unsupported or malformed files
+     *
+     * Coordinate files give a computed matrix (see fromCoordinates). An
+     * EDGE_WEIGHT_SECTION in FULL_MATRIX or one of the UPPER / LOWER row formats
+     * gives a triangular one (see fromTriangle).
+     */
+    static DistanceMatrix fromTSPLIB(std::istream& in, size_t rowCacheRows = 0,
+                                     RowCache::Policy policy = RowCache::Policy::Lru) {
+        return fromTSPLIB(TSPLIBHeader::read(in), in, rowCacheRows, policy);
+    }
+
+    /**
+     * @brief Reads the body of a TSPLIB file whose header was read already
+     * @param header Specification part, e.g. read first to plan memory
+     * @param in Stream positioned at the data section
+     */
+    static DistanceMatrix fromTSPLIB(const TSPLIBHeader& header, std::istream& in,
+                                     size_t rowCacheRows = 0,
+                                     RowCache::Policy policy = RowCache::Policy::Lru) {
+        if (header.edgeWeightType != "EXPLICIT") {
+            return fromCoordinates(
+                std::make_shared<const Coordinates>(Coordinates::fromTSPLIB(header, in)),
+                rowCacheRows, policy);
+        }
+
+        const std::string& format = header.edgeWeightFormat;
+        bool full = format == "FULL_MATRIX";
+        bool upper = format == "UPPER_ROW" || format == "UPPER_DIAG_ROW";
+        bool diagonal = format == "LOWER_DIAG_ROW" || format == "UPPER_DIAG_ROW";
+        if (!full && !upper && !diagonal && format != "LOWER_ROW") {
+            throw std::runtime_error("Unsupported EDGE_WEIGHT_FORMAT: " + format);
+        }
+        if (header.section != "EDGE_WEIGHT_SECTION") {
+            throw std::runtime_error("EXPLICIT weights need an EDGE_WEIGHT_SECTION");
+        }
+
+        size_t n = header.dimension;
+        std::vector<double> lower(n * (n + 1) / 2, 0.0);
+        for (size_t a = 0; a < n; ++a) {
+            size_t first = full ? 0 : upper ? (diagonal ? a : a + 1) : 0;
+            size_t last = full || upper ? n : (diagonal ? a + 1 : a);
+            for (size_t b = first; b < last; ++b) {
+                double value;
+                if (!(in >> value)) throw std::runtime_error("Truncated EDGE_WEIGHT_SECTION");
+                if (!full || b <= a) lower[triangleIndex(a, b)] = value;
+            }
+        }
+        return fromTriangle(n, std::move(lower), rowCacheRows, policy);
+    }
+
+    /**
+     * @brief Owned compact copy of a subset of a master matrix's cities
+     * @param master Matrix to read from
+     * @param cities Master index of each local city (distinct, in range)
+     * @throws std::runtime_error if the city list is empty or invalid
+     *
+     * Costs m^2 reads once and one m x m block shared by all threads, instead of
+     * a row cache per thread.
+     */
+    static DistanceMatrix gather(const DistanceMatrix& master, const std::vector<int>& cities) {
+        validateSubset(master.size(), cities);
+        size_t m = cities.size();
+        DistanceMatrix matrix(m);
+        for (size_t a = 0; a < m; ++a) {
+            const double* row = master[cities[a]];
+            double* out = matrix.mutableRow(a);
+            for (size_t b = 0; b < m; ++b) out[b] = row[cities[b]];
+        }
+        return matrix;
+    }
+
+    static constexpr size_t kDefaultCacheBytes = size_t(64) << 20; ///< Computed rows per thread
+
+    size_t size() const { return n_; }
+    bool empty() const { return n_ == 0; }
+    bool isMapped() const { return mapping_ != nullptr; }
+    bool isView() const { return master_ != nullptr; }
+    bool isComputed() const { return coordinates_ != nullptr; }
+    bool isTriangular() const { return !triangle_.empty(); }
+
+    /**
+     * @brief Cities and metric of a computed matrix (null otherwise)
+     */
+    const Coordinates* coordinates() const { return coordinates_.get(); }
+
+    /**
+     * @brief Type of the entries behind typedData()
+     */
+    Element element() const { return element_; }
+
+    /**
+     * @brief Entry (0, 0) of a borrowed float32 or int32 matrix (null otherwise); rows
+     *        are rowStride() elements apart
+     */
+    const void* typedData() const { return typed_; }
+
+    /**
+     * @brief Packed lower triangle of a triangular matrix (null otherwise)
+     */
+    const double* triangle() const { return triangle_.empty() ? nullptr : triangle_.data(); }
+
+    /**
+     * @brief Position of entry (a, b) in a packed lower triangle
+     */
+    static size_t triangleIndex(size_t a, size_t b) {
+        return a >= b ? a * (a + 1) / 2 + b : b * (b + 1) / 2 + a;
+    }
+
+    /**
+     * @brief Single entry read through the index map or coordinates, without touching
+     *        the row cache
+     */
+    double at(size_t a, size_t b) const {
+        if (master_) return master_->at(cities_[a], cities_[b]);
+        if (coordinates_) return coordinates_->distance(a, b);
+        if (typed_) return typedEntry(a * stride_ + b);
+        return triangle_.empty() ? data_[a * stride_ + b] : triangle_[triangleIndex(a, b)];
+    }
+
+    /**
+     * @brief Row a of the matrix
+     */
+    const double* operator[](size_t a) const {
+        return rowCached_ ? cachedRow(a) : data_ + a * stride_;
+    }
+
+    /**
+     * @brief Whole matrix as one row-major block (bypasses the row cache; null for views)
+     */
+    const double* data() const { return data_; }
+
+    /**
+     * @brief Distance between the starts of consecutive rows of data() or typedData(),
+     *        in elements
+     */
+    size_t rowStride() const { return stride_; }
+
+    /**
+     * @brief Writable row of an owned matrix
+     */
+    double* mutableRow(size_t a) { return owned_.data() + a * n_; }
+
+    /**
+     * @brief Tells the kernel how the mapping is about to be read (no-op when owned)
+     */
+    void advise(Access access) const {
+        if (!mapping_) return;
+        int advice = access == Access::Sequential ? MADV_SEQUENTIAL
+                   : access == Access::Random ? MADV_RANDOM : MADV_NORMAL;
+        ::madvise(mapping_, mappingBytes_, advice);
+    }
+
+    /**
+     * @brief Row cache hits and misses summed over all threads
+     */
+    std::pair<long long, long long> rowCacheStats() const {
+        std::lock_guard<std::mutex> lock(cacheMutex_);
+        long long hits = 0, misses = 0;
+        for (const auto& cache : caches_) {
+            if (!cache) continue;
+            hits += cache->hits();
+            misses += cache->misses();
+        }
+        return {hits, misses};
+    }
+
+    bool hasRowCache() const { return rowCached_; }
+
+private:
+    size_t n_ = 0;
+    size_t stride_ = 0; ///< Elements from one row start to the next (n unless borrowed)
+    std::vector<double> owned_;
+    const double* data_ = nullptr;
+    void* mapping_ = nullptr;
+    size_t mappingBytes_ = 0;
+    size_t rowCacheRows_ = 0;
+    RowCache::Policy rowCachePolicy_ = RowCache::Policy::Lru;
+    bool rowCached_ = false;                  ///< Rows are read through the calling thread's cache
+    uint64_t cacheId_ = nextCacheId();        ///< Never reused, keys the thread-local cache lookup
+    mutable std::mutex cacheMutex_;           ///< Guards caches_
+    mutable std::vector<std::unique_ptr<RowCache>> caches_; ///< One per thread that read a row
+    const DistanceMatrix* master_ = nullptr; ///< Matrix a view reads from
+    std::vector<int> cities_;                ///< Master index of each city of a view
+    std::shared_ptr<const Coordinates> coordinates_; ///< Source of computed rows
+    std::vector<double> triangle_;           ///< Packed lower triangle (fromTriangle)
+    const void* typed_ = nullptr;            ///< Borrowed float32 / int32 entries
+    Element element_ = Element::Float64;     ///< Type of the typed_ entries
+
+    /**
+     * @brief Routes rows of a computed or triangular matrix through the row cache
+     */
+    void enableComputedRows(size_t rowCacheRows, RowCache::Policy policy) {
+        rowCacheRows_ = rowCacheRows > 0
+            ? rowCacheRows
+            : std::max<size_t>(1, kDefaultCacheBytes / (n_ * sizeof(double)));
+        rowCachePolicy_ = policy;
+        rowCached_ = true;
+    }
+
+    /**
+     * @brief Shared body of the float32 and int32 borrow overloads
+     */
+    static DistanceMatrix borrowTyped(const void* data, Element element, size_t n,
+                                      size_t rowStride, size_t rowCacheRows,
+                                      RowCache::Policy policy) {
+        if (!data || n == 0 || rowStride < n) {
+            throw std::runtime_error("Invalid borrowed matrix");
+        }
+        DistanceMatrix matrix;
+        matrix.n_ = n;
+        matrix.stride_ = rowStride;
+        matrix.typed_ = data;
+        matrix.element_ = element;
+        matrix.enableComputedRows(rowCacheRows, policy);
+        return matrix;
+    }
+
+    /**
+     * @brief Entry at element offset k of a borrowed float32 or int32 matrix, as a double
+     */
+    double typedEntry(size_t k) const {
+        return element_ == Element::Float32
+            ? static_cast<double>(static_cast<const float*>(typed_)[k])
+            : static_cast<double>(static_cast<const int32_t*>(typed_)[k]);
+    }
+
+    /**
+     * @throws std::runtime_error unless cities are distinct indices below n
+     */
+    static void validateSubset(size_t n, const std::vector<int>& cities) {
+        if (cities.empty()) throw std::runtime_error("Empty subset");
+        std::vector<bool> seen(n, false);
+        for (int city : cities) {
+            if (city < 0 || static_cast<size_t>(city) >= n || seen[city]) {
+                throw std::runtime_error("Invalid subset city: " + std::to_string(city));
+            }
+            seen[city] = true;
+        }
+    }
+
+    /**
+     * @brief Validates and maps an open file or shared-memory descriptor (closes fd)
+     * @param fd Descriptor opened read-only
+     * @param label Name used in error messages
+     * @param rowCacheRows Rows cached per thread
+     * @param policy Row cache eviction order
+     */
+    static DistanceMatrix mapDescriptor(int fd, const std::string& label, size_t rowCacheRows,
+                                        RowCache::Policy policy) {
+        struct stat info;
+        MatrixFileHeader header;
+        bool valid = ::fstat(fd, &info) == 0 &&
+                     static_cast<size_t>(info.st_size) >= sizeof(header) &&
+                     ::pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+                     std::equal(kMagic, kMagic + 8, header.magic) &&
+                     static_cast<size_t>(info.st_size) ==
+                         sizeof(header) + header.n * header.n * sizeof(double);
+        if (!valid || header.n == 0) {
+            ::close(fd);
+            throw std::runtime_error("Invalid binary matrix file: " + label);
+        }
+
+        void* mapping = ::mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd); // The mapping keeps the file referenced
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("Cannot map " + label + ": " + std::strerror(errno));
+        }
+
+        DistanceMatrix matrix;
+        matrix.n_ = header.n;
+        matrix.stride_ = header.n;
+        matrix.mapping_ = mapping;
+        matrix.mappingBytes_ = info.st_size;
+        matrix.data_ = reinterpret_cast<const double*>(static_cast<const char*>(mapping) +
+                                                       sizeof(header));
+        if (rowCacheRows > 0) {
+            matrix.rowCacheRows_ = rowCacheRows;
+            matrix.rowCachePolicy_ = policy;
+            matrix.rowCached_ = true;
+        }
+        matrix.advise(Access::Random);
+        return matrix;
+    }
+
+    static uint64_t nextCacheId() {
+        static std::atomic<uint64_t> counter{1};
+        return counter.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Row a through the row cache owned by the calling thread
+     *
+     * Caches belong to OS threads, not OpenMP thread numbers, so solves running
+     * concurrently on one matrix (each with its own team numbered from 0) never
+     * share a cache. The last matrix used is memoized, so the common case is two
+     * thread-local loads.
+     */
+    const double* cachedRow(size_t a) const {
+        thread_local uint64_t lastId = 0;
+        thread_local RowCache* last = nullptr;
+        if (lastId != cacheId_) {
+            thread_local std::unordered_map<uint64_t, RowCache*> mine; // Ids are never reused
+            RowCache*& cache = mine[cacheId_];
+            if (!cache) {
+                std::lock_guard<std::mutex> lock(cacheMutex_);
+                caches_.push_back(std::make_unique<RowCache>(rowCacheRows_, n_, rowCachePolicy_));
+                cache = caches_.back().get();
+            }
+            lastId = cacheId_;
+            last = cache;
+        }
+        if (master_) return last->get(a, (*master_)[cities_[a]], cities_.data());
+        if (coordinates_) {
+            return last->get(a, [this, a](double* out) { coordinates_->row(a, out); });
+        }
+        if (typed_) {
+            return last->get(a, [this, a](double* out) {
+                for (size_t b = 0; b < n_; ++b) out[b] = typedEntry(a * stride_ + b);
+            });
+        }
+        if (!triangle_.empty()) {
+            return last->get(a, [this, a](double* out) {
+                const double* lower = triangle_.data() + triangleIndex(a, 0);
+                std::copy(lower, lower + a + 1, out);
+                for (size_t b = a + 1; b < n_; ++b) out[b] = triangle_[triangleIndex(b, a)];
+            });
+        }
+        return last->get(a, data_ + a * stride_);
+    }
+
+    void unmap() {
+        if (mapping_) ::munmap(mapping_, mappingBytes_);
+        mapping_ = nullptr;
+    }
+};
+
+/**
+ * @struct DenseDistance
+ * @brief Distance policy over a row-major block: one load per entry
+ *
+ * Distance policies are small copyable callables, (a, b) -> distance, that the
+ * search kernels take as a template parameter; each kernel is compiled once per
+ * policy with the lookup inlined, and TSPSolver::withDistance picks the
+ * instantiation at run time.
+ */
+struct DenseDistance {
+    const double* data; ///< Entry (0, 0)
+    size_t stride;      ///< Doubles from one row start to the next
+
+    double operator()(int a, int b) const { return data[static_cast<size_t>(a) * stride + b]; }
+};
+
+/**
+ * @struct TypedDistance
+ * @brief Distance policy over a borrowed float32 or int32 block, converting each entry
+ */
+template <typename T>
+struct TypedDistance {
+    const T* data; ///< Entry (0, 0)
+    size_t stride; ///< Elements from one row start to the next
+
+    double operator()(int a, int b) const {
+        return static_cast<double>(data[static_cast<size_t>(a) * stride + b]);
+    }
+};
+
+/**
+ * @struct TriangularDistance
+ * @brief Distance policy over a packed lower triangle (symmetric matrices)
+ */
+struct TriangularDistance {
+    const double* lower; ///< See DistanceMatrix::fromTriangle
+
+    double operator()(int a, int b) const { return lower[DistanceMatrix::triangleIndex(a, b)]; }
+};
+
+/**
+ * @struct CoordinateDistance
+ * @brief Distance policy computing each entry from coordinates, metric fixed at compile time
+ */
+template <Coordinates::Metric M>
+struct CoordinateDistance {
+    const Coordinates* coordinates;
+
+    double operator()(int a, int b) const { return coordinates->distance<M>(a, b); }
+};
+
+/**
+ * @struct FunctionDistance
+ * @brief Distance policy over any callable, such as a lambda, inlined like the others
+ */
+template <typename F>
+struct FunctionDistance {
+    F function;
+
+    double operator()(int a, int b) const { return function(a, b); }
+};
+
+template <typename F>
+FunctionDistance(F) -> FunctionDistance<F>;
+
+/**
+ * @struct CachedDistance
+ * @brief Distance policy reading whole rows of a view or mapped matrix through its row cache
+ */
+struct CachedDistance {
+    const DistanceMatrix* matrix;
+
+    double operator()(int a, int b) const { return (*matrix)[a][b]; }
+};
+
+/**
+ * @class QuantizedMatrix
+ * @brief 8-bit copy of the distance matrix used to prescreen 2-opt candidates
+ *
+ * Row a is stored as q[a][b] = floor((d[a][b] - rowMin[a]) / rowScale[a]), one byte
+ * per entry, so rowMin[a] + q[a][b] * rowScale[a] is a lower bound on d[a][b] that
+ * is never more than rowScale[a] too small. The working set is an eighth of the
+ * doubles, so far more of it stays in cache during a scan.
+ */
+class QuantizedMatrix {
+public:
+    QuantizedMatrix() = default;
+
+    /**
+     * @brief Unfilled n x n copy; every row must be set with quantizeRow
+     */
+    explicit QuantizedMatrix(size_t n)
+        : n_(n), values_(n_ * n_), rowMin_(n_), rowScale_(n_) {}
+
+    explicit QuantizedMatrix(const DistanceMatrix& matrix) : QuantizedMatrix(matrix.size()) {
+        for (size_t a = 0; a < n_; ++a) {
+            quantizeRow(a, matrix[a]);
+        }
+    }
+
+    /**
+     * @brief Quantizes one row; distinct rows may be set concurrently
+     * @param a Row index
+     * @param row The n distances of row a
+     */
+    void quantizeRow(size_t a, const double* row) {
+        auto [lo, hi] = std::minmax_element(row, row + n_);
+        rowMin_[a] = *lo;
+        rowScale_[a] = *hi > *lo ? (*hi - *lo) / 255.0 : 1.0;
+        for (size_t b = 0; b < n_; ++b) {
+            double q = std::floor((row[b] - rowMin_[a]) / rowScale_[a]);
+            q = std::min(255.0, std::max(0.0, q));
+            // Guard against rounding: the decoded value must not exceed the original
+            while (q > 0.0 && rowMin_[a] + q * rowScale_[a] > row[b]) q -= 1.0;
+            values_[a * n_ + b] = static_cast<uint8_t>(q);
+        }
+    }
+
+    bool empty() const { return n_ == 0; }
+    const uint8_t* row(int a) const { return values_.data() + static_cast<size_t>(a) * n_; }
+    double rowMin(int a) const { return rowMin_[a]; }
+    double rowScale(int a) const { return rowScale_[a]; }
+
+private:
+    size_t n_ = 0;
+    std::vector<uint8_t> values_;
+    std::vector<double> rowMin_;
+    std::vector<double> rowScale_;
+};
+
+/**
+ * @class CompressedInput
+ * @brief Stream buffer over a plain, gzip or zstd input file, decoded in chunks
+ *
+ * The format is detected from the first bytes of the file. Compressed input is
+ * decoded one chunk at a time straight into the stream the CSV reader consumes,
+ * so no zcat process or pipe copy sits in front of the parser and memory stays
+ * at two chunks however large the file is. Concatenated gzip members (bgzip,
+ * pigz --independent) and multi-frame zstd files are read to the end.
+ *
+ * gzip needs -DTSP_HAVE_ZLIB -lz and zstd needs -DTSP_HAVE_ZSTD -lzstd; without
+ * them such files are rejected with a message naming the missing flag.
+ */
+class CompressedInput : public std::streambuf {
+public:
+    /// Encoding of the input file
+    enum class Format { Plain, Gzip, Zstd };
+
+    static constexpr size_t kChunkBytes = size_t(1) << 20; ///< Read and decode granularity
+
+    /**
+     * @brief Opens a file and detects its format
+     * @throws std::runtime_error if the file cannot be read or its codec is not compiled in
+     */
+    explicit CompressedInput(const std::string& path)
+        : path_(path), in_(kChunkBytes), out_(kChunkBytes) {
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        if (fd_ < 0) {
+            throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+        }
+        ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+        refill();
+
+        const unsigned char* magic = reinterpret_cast<const unsigned char*>(in_.data());
+        if (inEnd_ >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+            format_ = Format::Gzip;
+        } else if (inEnd_ >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 &&
+                   magic[2] == 0x2f && magic[3] == 0xfd) {
+            format_ = Format::Zstd;
+        }
+
+        if (format_ == Format::Gzip) {
+#ifdef TSP_HAVE_ZLIB
+            zstream_ = std::make_unique<z_stream>();
+            // 15 + 16: gzip wrapper with the largest window
+            if (inflateInit2(zstream_.get(), 15 + 16) != Z_OK) {
+                zstream_.reset();
+                fail("cannot initialise zlib");
+            }
+#else
+            fail("gzip input needs a build with -DTSP_HAVE_ZLIB -lz");
+#endif
+        } else if (format_ == Format::Zstd) {
+#ifdef TSP_HAVE_ZSTD
+            dstream_ = ZSTD_createDStream();
+            if (!dstream_) fail("cannot initialise zstd");
+#else
+            fail("zstd input needs a build with -DTSP_HAVE_ZSTD -lzstd");
+#endif
+        } else {
+            setg(in_.data(), in_.data(), in_.data() + inEnd_);
+        }
+    }
+
+    CompressedInput(const CompressedInput&) = delete;
+    CompressedInput& operator=(const CompressedInput&) = delete;
+
+    ~CompressedInput() override {
+#ifdef TSP_HAVE_ZLIB
+        if (zstream_) inflateEnd(zstream_.get());
+#endif
+#ifdef TSP_HAVE_ZSTD
+        if (dstream_) ZSTD_freeDStream(dstream_);
+#endif
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    Format format() const { return format_; }
+
+protected:
+    /**
+     * @brief Makes the next decoded chunk readable
+     * @throws std::runtime_error on read errors and corrupt or truncated input
+     *
+     * Errors propagate to the reader when its istream has badbit in exceptions().
+     */
+    int_type underflow() override {
+        if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+        size_t produced = 0;
+        switch (format_) {
+            case Format::Plain:
+                if (refill() > 0) produced = inEnd_;
+                if (produced) setg(in_.data(), in_.data(), in_.data() + inEnd_);
+                break;
+            case Format::Gzip:
+                produced = inflateChunk();
+                break;
+            case Format::Zstd:
+                produced = decompressChunk();
+                break;
+        }
+        if (format_ != Format::Plain && produced) {
+            setg(out_.data(), out_.data(), out_.data() + produced);
+        }
+        return produced ? traits_type::to_int_type(*gptr()) : traits_type::eof();
+    }
+
+private:
+    std::string path_;          ///< For error messages
+    int fd_ = -1;               ///< Input file
+    Format format_ = Format::Plain;
+    std::vector<char> in_;      ///< Raw bytes read from the file
+    size_t inPos_ = 0;          ///< First unconsumed byte of in_
+    size_t inEnd_ = 0;          ///< End of the valid bytes of in_
+    std::vector<char> out_;     ///< Decoded bytes handed to the reader
+    bool streamEnded_ = true;   ///< Last gzip member / zstd frame was complete
+#ifdef TSP_HAVE_ZLIB
+    std::unique_ptr<z_stream> zstream_;
+#endif
+#ifdef TSP_HAVE_ZSTD
+    ZSTD_DStream* dstream_ = nullptr;
+#endif
+
+    [[noreturn]] void fail(const std::string& what) const {
+        throw std::runtime_error(path_ + ": " + what);
+    }
+
+    /**
+     * @brief Reads the next raw chunk into in_
+     * @return Bytes read, 0 at end of file
+     */
+    size_t refill() {
+        ssize_t got;
+        do {
+            got = ::read(fd_, in_.data(), in_.size());
+        } while (got < 0 && errno == EINTR);
+        if (got < 0) fail(std::string("read failed: ") + std::strerror(errno));
+        inPos_ = 0;
+        inEnd_ = static_cast<size_t>(got);
+        return inEnd_;
+    }
+
+    /**
+     * @brief Inflates up to one chunk of gzip data into out_
+     * @return Bytes decoded, 0 at the end of the last member
+     */
+    size_t inflateChunk() {
+#ifdef TSP_HAVE_ZLIB
+        z_stream& zs = *zstream_;
+        zs.next_out = reinterpret_cast<Bytef*>(out_.data());
+        zs.avail_out = static_cast<uInt>(out_.size());
+        while (zs.avail_out == out_.size()) {
+            if (inPos_ == inEnd_ && refill() == 0) {
+                if (!streamEnded_) fail("truncated gzip stream");
+                return 0;
+            }
+            if (streamEnded_) {
+                inflateReset(&zs); // Next member of a concatenated file
+                streamEnded_ = false;
+            }
+            zs.next_in = reinterpret_cast<Bytef*>(in_.data() + inPos_);
+            zs.avail_in = static_cast<uInt>(inEnd_ - inPos_);
+            int status = inflate(&zs, Z_NO_FLUSH);
+            inPos_ = inEnd_ - zs.avail_in;
+            if (status == Z_STREAM_END) {
+                streamEnded_ = true;
+            } else if (status != Z_OK && status != Z_BUF_ERROR) {
+                fail(std::string("corrupt gzip stream: ") + (zs.msg ? zs.msg : "unknown error"));
+            }
+        }
+        return out_.size() - zs.avail_out;
+#else
+        return 0;
+#endif
+    }
+
+    /**
+     * @brief Decompresses up to one chunk of zstd data into out_
+     * @return Bytes decoded, 0 at the end of the last frame
+     */
+    size_t decompressChunk() {
+#ifdef TSP_HAVE_ZSTD
+        ZSTD_outBuffer output{out_.data(), out_.size(), 0};
+        while (output.pos == 0) {
+            if (inPos_ == inEnd_ && refill() == 0) {
+                if (!streamEnded_) fail("truncated zstd stream");
+                return 0;
+            }
+            ZSTD_inBuffer input{in_.data(), inEnd_, inPos_};
+            size_t hint = ZSTD_decompressStream(dstream_, &output, &input);
+            if (ZSTD_isError(hint)) {
+                fail(std::string("corrupt zstd stream: ") + ZSTD_getErrorName(hint));
+            }
+            inPos_ = input.pos;
+            streamEnded_ = hint == 0; // 0: a frame was completed and flushed
+        }
+        return output.pos;
+#else
+        return 0;
+#endif
+    }
+};
+
+/// Nearest neighbours of each city, closest first
+using NeighborLists = std::vector<std::vector<int>>;
+
+/**
+ * @struct Preprocessing
+ * @brief Derived tables to build while an instance is being loaded
+ */
+struct Preprocessing {
+    int neighborListSize = 0; ///< Neighbour lists of this size (0: none)
+    bool quantize = false;    ///< 8-bit prescreen copy
+
+    bool empty() const { return neighborListSize <= 0 && !quantize; }
+};
+
+/**
+ * @struct MemoryPlan
+ * @brief Matrix representation and table sizes chosen to fit a memory budget
+ *
+ * Byte counts are estimates of resident memory. Pages of a mapped file are not
+ * counted: they live in the page cache, which the kernel reclaims under
+ * pressure instead of killing the process.
+ */
+struct MemoryPlan {
+    /// Where the distances come from
+    enum class Source {
+        Csv,         ///< Dense CSV matrix (any representation)
+        Explicit,    ///< TSPLIB EXPLICIT weights (triangular)
+        Coordinates, ///< TSPLIB coordinates (computed)
+        Mapped       ///< Binary file or shared-memory segment (mapped)
+    };
+
+    /// How the distances are held
+    enum class Storage {
+        Dense,      ///< n x n doubles in memory
+        Triangular, ///< Packed lower triangle, rows unfolded into the row cache
+        Mapped,     ///< Out-of-core: binary file mapped read-only
+        Computed    ///< Coordinates, rows computed into the row cache
+    };
+
+    Storage storage = Storage::Dense;
+    size_t rowCacheRows = 0;  ///< Rows cached per thread (0: none, or the loader's default)
+    bool quantize = false;    ///< Build the 8-bit prescreen copy
+    bool edgeBitmap = false;  ///< Keep the diverse-init edge bitmap
+    size_t matrixBytes = 0;   ///< Distances (or coordinates) held in memory
+    size_t cacheBytes = 0;    ///< Row caches of all threads
+    size_t tableBytes = 0;    ///< Neighbour lists, quantized copy, edge bitmap
+    size_t solveBytes = 0;    ///< Tours and prefix sums of all threads
+
+    size_t totalBytes() const { return matrixBytes + cacheBytes + tableBytes + solveBytes; }
+};
+
+/**
+ * @brief Returns the name of a storage as printed by --mem-report
+ */
+inline const char* storageName(MemoryPlan::Storage storage) {
+    switch (storage) {
+        case MemoryPlan::Storage::Dense: return "dense";
+        case MemoryPlan::Storage::Triangular: return "triangular";
+        case MemoryPlan::Storage::Mapped: return "mapped";
+        case MemoryPlan::Storage::Computed: return "computed";
+    }
+    return "?";
+}
+
+/**
+ * @struct MemoryBudget
+ * @brief Memory limit of a run and what the search will keep besides the matrix
+ */
+struct MemoryBudget {
+    size_t limitBytes = 0;    ///< 0: no limit, plan only for reporting
+    int threads = 1;          ///< Threads that each hold a row cache and tours
+    size_t rowCacheRows = 0;  ///< Rows per thread fixed by --row-cache (0: planned)
+    RowCache::Policy rowCachePolicy = RowCache::Policy::Lru; ///< For the planned caches
+    Preprocessing tables;     ///< Tables the search will build
+    bool edgeBitmap = false;  ///< Diverse init keeps an n(n-1)/2-bit edge bitmap
+
+    /// Per-thread tour state (tour, positions, prefix sums, best tour), per city
+    static constexpr size_t kSolveBytesPerCity = 64;
+
+    /**
+     * @brief Chooses how to hold an n-city instance within the limit
+     * @param n Number of cities
+     * @param source Input kind, which decides the representations available
+     * @throws std::runtime_error if nothing fits, naming the smallest requirement
+     *
+     * Representations are tried from the fastest down (dense, triangular,
+     * mapped for a CSV matrix) and the first that fits wins; a row cache gets
+     * what the rest leaves, up to its default size. Only if no representation
+     * fits are optional tables dropped: the quantized copy first, then the
+     * edge bitmap (diverse init falls back to random starts).
+     */
+    MemoryPlan plan(size_t n, MemoryPlan::Source source) const {
+        using Storage = MemoryPlan::Storage;
+        std::vector<Storage> storages;
+        switch (source) {
+            case MemoryPlan::Source::Csv:
+                storages = {Storage::Dense, Storage::Triangular, Storage::Mapped};
+                break;
+            case MemoryPlan::Source::Explicit: storages = {Storage::Triangular}; break;
+            case MemoryPlan::Source::Coordinates: storages = {Storage::Computed}; break;
+            case MemoryPlan::Source::Mapped: storages = {Storage::Mapped}; break;
+        }
+
+        size_t needed = std::numeric_limits<size_t>::max();
+        for (int dropped = 0; dropped <= 2; ++dropped) {
+            bool quantize = tables.quantize && dropped < 1;
+            bool bitmap = edgeBitmap && dropped < 2;
+            for (Storage storage : storages) {
+                MemoryPlan plan = estimate(n, storage, quantize, bitmap);
+                if (limitBytes == 0 || plan.totalBytes() <= limitBytes) return plan;
+                needed = std::min(needed, plan.totalBytes());
+            }
+        }
+        auto size = [](size_t bytes) {
+            std::ostringstream text;
+            text << std::fixed << std::setprecision(1);
+            if (bytes < (size_t(1) << 20)) text << bytes / 1024.0 << " KiB";
+            else text << bytes / 1048576.0 << " MiB";
+            return text.str();
+        };
+        throw std::runtime_error("Memory limit of " + size(limitBytes) + " is below the " +
+                                 size(needed) + " needed for " + std::to_string(n) + " cities");
+    }
+
+private:
+    /**
+     * @brief Byte counts of one representation, with the row cache sized to the limit
+     */
+    MemoryPlan estimate(size_t n, MemoryPlan::Storage storage, bool quantize,
+                        bool bitmap) const {
+        using Storage = MemoryPlan::Storage;
+        MemoryPlan plan;
+        plan.storage = storage;
+        plan.quantize = quantize;
+        plan.edgeBitmap = bitmap;
+        switch (storage) {
+            case Storage::Dense: plan.matrixBytes = n * n * sizeof(double); break;
+            case Storage::Triangular:
+                plan.matrixBytes = n * (n + 1) / 2 * sizeof(double);
+                break;
+            case Storage::Mapped: break;
+            case Storage::Computed: plan.matrixBytes = 6 * n * sizeof(double); break;
+        }
+        size_t k = std::min<size_t>(std::max(tables.neighborListSize, 0), n - 1);
+        plan.tableBytes = (k > 0 ? n * (k * sizeof(int) + sizeof(std::vector<int>)) : 0) +
+                          (quantize ? n * n + 2 * n * sizeof(double) : 0) +
+                          (bitmap ? EdgeUsageBitmap::bytes(n) : 0);
+        size_t threadCount = static_cast<size_t>(std::max(threads, 1));
+        plan.solveBytes = threadCount * n * kSolveBytesPerCity;
+
+        // Triangular and computed rows need a cache; a mapping only has one on request
+        bool cached = storage == Storage::Triangular || storage == Storage::Computed;
+        size_t rows = rowCacheRows;
+        if (rows == 0 && cached) {
+            size_t rowBytes = std::max<size_t>(n, 1) * sizeof(double);
+            rows = std::max<size_t>(1, DistanceMatrix::kDefaultCacheBytes / rowBytes);
+            size_t used = plan.totalBytes();
+            if (limitBytes > 0) {
+                size_t spare = limitBytes > used ? limitBytes - used : 0;
+                size_t slotBytes = threadCount * n * sizeof(int); // Per cache, not per row
+                spare = spare > slotBytes ? spare - slotBytes : 0;
+                rows = std::min(rows, spare / (threadCount * n * sizeof(double)));
+                rows = std::max(rows, RowCache::kMinRows); // Below this the plan does not fit
+            }
+            rows = std::min(rows, n);
+        }
+        plan.rowCacheRows = rows;
+        if (rows > 0) {
+            size_t resident = std::min(std::max(rows, RowCache::kMinRows), n);
+            plan.cacheBytes = threadCount * (resident * n * sizeof(double) + n * sizeof(int));
+        }
+        return plan;
+    }
+};
+
+/**
+ * @class PeakMemory
+ * @brief Peak resident set size of each phase of a run
+ *
+ * Linux lets a process reset its RSS high-water mark (by writing 5 to
+ * /proc/self/clear_refs), so every phase reports its own peak. Where the reset
+ * fails, a phase reports the peak since the process started.
+ */
+class PeakMemory {
+public:
+    /**
+     * @brief Ends the current phase, if any, and starts the next one
+     */
+    void start(const std::string& phase) {
+        stop();
+        std::ofstream clear("/proc/self/clear_refs");
+        clear << "5";
+        clear.close();
+        resettable_ = resettable_ && static_cast<bool>(clear);
+        current_ = phase;
+    }
+
+    /**
+     * @brief Ends the current phase and records its peak
+     */
+    void stop() {
+        if (current_.empty()) return;
+        phases_.emplace_back(current_, peakBytes());
+        current_.clear();
+    }
+
+    /**
+     * @brief (phase, peak bytes) of every finished phase, in order
+     */
+    const std::vector<std::pair<std::string, size_t>>& phases() const { return phases_; }
+
+    /**
+     * @brief Whether each phase's peak is its own rather than the process's so far
+     */
+    bool perPhase() const { return resettable_; }
+
+    /**
+     * @brief Peak RSS since the last reset (VmHWM), or since process start
+     */
+    static size_t peakBytes() {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line)) {
+            if (line.rfind("VmHWM:", 0) == 0) return std::stoul(line.substr(6)) * 1024;
+        }
+        struct rusage usage;
+        ::getrusage(RUSAGE_SELF, &usage);
+        return static_cast<size_t>(usage.ru_maxrss) * 1024; // Kilobytes on Linux
+    }
+
+private:
+    std::string current_;
+    std::vector<std::pair<std::string, size_t>> phases_;
+    bool resettable_ = true;
+};
+
+/**
+ * @class Instance
+ * @brief Immutable problem data shared by any number of solves
+ *
+ * Holds the distance matrix and the derived tables that depend only on it
+ * (neighbour lists per list size, the quantized copy). Derived tables are built
+ * on first request, once, under a lock, and handed out as shared read-only
+ * pointers, so concurrent solvers on one instance never copy or rebuild them.
+ */
+class Instance {
+public:
+    /**
+     * @brief Takes ownership of a matrix (owned, mapped, attached or a view)
+     * @throws std::runtime_error if the matrix is empty
+     */
+    explicit Instance(DistanceMatrix matrix) : matrix_(std::move(matrix)) {
+        if (matrix_.empty()) {
+            throw std::runtime_error("Invalid adjacency matrix");
+        }
+    }
+
+    static constexpr size_t kPipelineRows = 64; ///< Rows handed to preprocessing at a time
+
+    /**
+     * @brief Loads the adjacency matrix from a CSV stream
+     * @param in CSV rows (the parameter line already consumed)
+     * @param preprocessing Derived tables to build during the load
+     * @param budget Memory limit; the representation is planned once n is known
+     * @param plan Output: the plan the load followed (may be null)
+     * @return Shared instance, with the requested tables already in place
+     * @throws std::runtime_error if matrix is invalid or not square, or does not fit
+     *
+     * The tables depend on one row each, so the load is a pipeline: one thread
+     * parses rows while the others preprocess every completed block of
+     * kPipelineRows rows. Only the rows parsed last are preprocessed after the
+     * input ends, instead of a full pass over the matrix. A plan other than
+     * dense streams the rows to disk instead (see loadOutOfCore), and its tables
+     * are built later by prepare.
+     */
+    static std::shared_ptr<const Instance> fromCSV(std::istream& in,
+                                                   const Preprocessing& preprocessing = {},
+                                                   const MemoryBudget& budget = {},
+                                                   MemoryPlan* plan = nullptr) {
+        std::string line;
+        if (!std::getline(in, line)) {
+            throw std::runtime_error("Invalid adjacency matrix in CSV file");
+        }
+        std::vector<double> row = parseCSVLine(line);
+        size_t n = row.size();
+        if (n == 0) throw std::runtime_error("Invalid adjacency matrix in CSV file");
+
+        MemoryPlan planned = budget.plan(n, MemoryPlan::Source::Csv);
+        if (plan) *plan = planned;
+        if (planned.storage != MemoryPlan::Storage::Dense) {
+            DistanceMatrix spilled = loadOutOfCore(in, row, planned, budget.rowCachePolicy);
+            if (plan && spilled.isMapped()) { // Asymmetric: the triangle was not kept
+                plan->storage = MemoryPlan::Storage::Mapped;
+                plan->matrixBytes = 0;
+            }
+            return std::make_shared<const Instance>(std::move(spilled));
+        }
+        Preprocessing tables = preprocessing;
+        tables.quantize = tables.quantize && (budget.limitBytes == 0 || planned.quantize);
+
+        DistanceMatrix matrix(n);
+        std::copy(row.begin(), row.end(), matrix.mutableRow(0));
+
+        // Reads rows 1..n-1 straight into the matrix, reporting each finished block
+        auto readRows = [&](const std::function<void(size_t)>& rowsDone) {
+            size_t rows = 1;
+            while (std::getline(in, line)) {
+                row = parseCSVLine(line);
+                if (rows == n || row.size() != n) {
+                    throw std::runtime_error("Invalid adjacency matrix in CSV file");
+                }
+                std::copy(row.begin(), row.end(), matrix.mutableRow(rows));
+                if (++rows % kPipelineRows == 0) rowsDone(rows);
+            }
+            if (rows != n) throw std::runtime_error("Invalid adjacency matrix in CSV file");
+            rowsDone(rows);
+        };
+
+        if (tables.empty()) {
+            readRows([](size_t) {});
+            return std::make_shared<const Instance>(std::move(matrix));
+        }
+
+        int k = std::max(0, std::min(tables.neighborListSize, static_cast<int>(n) - 1));
+        NeighborLists lists(tables.neighborListSize > 0 ? n : 0);
+        auto quantized = tables.quantize ? std::make_shared<QuantizedMatrix>(n) : nullptr;
+
+        std::mutex progressMutex;
+        std::condition_variable progress;
+        size_t rowsRead = 1;   // Rows complete in matrix (guarded by progressMutex)
+        bool finished = false; // Reader done, successfully or not
+        std::exception_ptr error;
+        std::atomic<size_t> nextRow{0};
+
+        #pragma omp parallel
+        {
+            #pragma omp single nowait
+            {
+                try {
+                    readRows([&](size_t rows) {
+                        std::lock_guard<std::mutex> lock(progressMutex);
+                        rowsRead = rows;
+                        progress.notify_all();
+                    });
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                std::lock_guard<std::mutex> lock(progressMutex);
+                finished = true;
+                progress.notify_all();
+            }
+
+            // Every thread, the reader once it is done, preprocesses finished blocks
+            std::vector<int> order(n);
+            for (;;) {
+                size_t begin = nextRow.fetch_add(kPipelineRows);
+                if (begin >= n) break;
+                size_t end = std::min(n, begin + kPipelineRows);
+                {
+                    std::unique_lock<std::mutex> lock(progressMutex);
+                    progress.wait(lock, [&] { return rowsRead >= end || finished; });
+                    if (rowsRead < end) break; // The load failed
+                }
+                for (size_t a = begin; a < end; ++a) {
+                    const double* values = matrix[a];
+                    if (!lists.empty()) nearestNeighbors(values, static_cast<int>(a), k,
+                                                         order, lists[a]);
+                    if (quantized) quantized->quantizeRow(a, values);
+                }
+            }
+        }
+        if (error) std::rethrow_exception(error);
+
+        auto instance = std::make_shared<Instance>(std::move(matrix));
+        if (!lists.empty()) {
+            instance->neighborLists_[tables.neighborListSize] =
+                std::make_shared<const NeighborLists>(std::move(lists));
+        }
+        instance->quantized_ = std::move(quantized);
+        return instance;
+    }
+
+    /**
+     * @brief Parses a CSV line into a vector of doubles
+     * @param line Comma-separated string of numbers
+     * @return Vector of parsed double values
+     */
+    static std::vector<double> parseCSVLine(const std::string& line) {
+        std::vector<double> row;
+        std::stringstream ss(line);
+        std::string cell;
+        // Split by comma and convert to double
+        while (std::getline(ss, cell, ',')) {
+            row.push_back(std::stod(cell));
+        }
+        return row;
+    }
+
+    /**
+     * @brief Streams a CSV matrix into the binary format used by --matrix
+     * @param in CSV rows (the parameter line already consumed)
+     * @param path Output file
+     * @return Number of cities written
+     * @throws std::runtime_error if the matrix is not square or the file cannot be written
+     *
+     * Only one row is held in memory at a time, so matrices far larger than RAM
+     * can be converted.
+     */
+    static size_t convertToBinary(std::istream& in, const std::string& path) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out) throw std::runtime_error("Cannot write " + path);
+
+        MatrixFileHeader header{};
+        std::copy(DistanceMatrix::kMagic, DistanceMatrix::kMagic + 8, header.magic);
+        std::string line;
+        size_t rows = 0;
+        while (std::getline(in, line)) {
+            std::vector<double> row = parseCSVLine(line);
+            if (rows == 0) {
+                header.n = row.size();
+                out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            }
+            if (row.size() != header.n) break;
+            out.write(reinterpret_cast<const char*>(row.data()), row.size() * sizeof(double));
+            ++rows;
+        }
+        out.close();
+        if (rows == 0 || rows != header.n || !out) {
+            std::remove(path.c_str());
+            throw std::runtime_error("Invalid adjacency matrix in CSV file");
+        }
+        return rows;
+    }
+
+    const DistanceMatrix& matrix() const { return matrix_; }
+    size_t size() const { return matrix_.size(); }
+
+    /**
+     * @brief Builds the requested tables now rather than on first use
+     *
+     * Lets a run account the memory and time of preprocessing to its own phase.
+     */
+    void prepare(const Preprocessing& preprocessing) const {
+        if (preprocessing.neighborListSize > 0) neighborLists(preprocessing.neighborListSize);
+        if (preprocessing.quantize) quantized();
+    }
+
+    /**
+     * @brief k-nearest-neighbour lists, built on the first request for this k
+     */
+    std::shared_ptr<const NeighborLists> neighborLists(int k) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::shared_ptr<const NeighborLists>& lists = neighborLists_[k];
+        if (!lists) lists = std::make_shared<const NeighborLists>(buildNeighborLists(k));
+        return lists;
+    }
+
+    /**
+     * @brief 8-bit prescreen copy of the matrix, built on the first request
+     */
+    std::shared_ptr<const QuantizedMatrix> quantized() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!quantized_) quantized_ = std::make_shared<const QuantizedMatrix>(matrix_);
+        return quantized_;
+    }
+
+private:
+    DistanceMatrix matrix_; ///< Distance matrix between cities
+    mutable std::mutex mutex_; ///< Guards the lazily built tables below
+    mutable std::map<int, std::shared_ptr<const NeighborLists>> neighborLists_; ///< By list size
+    mutable std::shared_ptr<const QuantizedMatrix> quantized_; ///< --quantize prescreen
+
+    /**
+     * @brief Streams the remaining CSV rows into a triangular or mapped matrix
+     * @param in CSV rows after the first
+     * @param first Parsed first row
+     * @param plan Triangular or Mapped plan
+     * @param policy Row cache eviction order
+     * @throws std::runtime_error if matrix is invalid or the spill file cannot be written
+     *
+     * Rows go to an unlinked binary file in $TMPDIR (or /tmp), one row in memory
+     * at a time. A triangular plan also keeps the lower triangle and checks
+     * symmetry on the fly: every entry adds a hash of (pair, value) to the
+     * column of its mirror, and every mirror subtracts it again, so a row's
+     * column sums to zero once the row is read only if it matched all its
+     * mirrors. An asymmetric matrix falls back to mapping the file.
+     */
+    static DistanceMatrix loadOutOfCore(std::istream& in, const std::vector<double>& first,
+                                        const MemoryPlan& plan, RowCache::Policy policy) {
+        size_t n = first.size();
+        const char* directory = std::getenv("TMPDIR");
+        std::string path = std::string(directory && *directory ? directory : "/tmp") +
+                           "/tsp-matrix-XXXXXX";
+        int fd = ::mkstemp(&path[0]);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot create spill file " + path + ": " +
+                                     std::strerror(errno));
+        }
+        ::close(fd);
+        struct Remove {
+            const std::string& path;
+            ~Remove() { std::remove(path.c_str()); }
+        } remove{path};
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        MatrixFileHeader header{};
+        std::copy(DistanceMatrix::kMagic, DistanceMatrix::kMagic + 8, header.magic);
+        header.n = n;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        bool triangular = plan.storage == MemoryPlan::Storage::Triangular;
+        std::vector<double> lower(triangular ? n * (n + 1) / 2 : 0);
+        std::vector<uint64_t> mirrors(triangular ? n : 0, 0);
+        bool symmetric = triangular;
+        auto pairHash = [n](size_t a, size_t b, double value) {
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            uint64_t x = (std::min(a, b) * n + std::max(a, b)) ^ (bits * 0x9e3779b97f4a7c15ULL);
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL; // splitmix64 finalizer
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+            return x ^ (x >> 31);
+        };
+
+        std::vector<double> row = first;
+        std::string line;
+        for (size_t a = 0;; ++a) {
+            out.write(reinterpret_cast<const char*>(row.data()), n * sizeof(double));
+            if (symmetric) {
+                for (size_t b = 0; b < a; ++b) mirrors[a] -= pairHash(a, b, row[b]);
+                for (size_t b = a + 1; b < n; ++b) mirrors[b] += pairHash(a, b, row[b]);
+                symmetric = mirrors[a] == 0;
+                std::copy(row.begin(), row.begin() + a + 1,
+                          lower.begin() + DistanceMatrix::triangleIndex(a, 0));
+            }
+            if (a + 1 == n || !std::getline(in, line)) {
+                if (a + 1 != n) throw std::runtime_error("Invalid adjacency matrix in CSV file");
+                break;
+            }
+            row = parseCSVLine(line);
+            if (row.size() != n) throw std::runtime_error("Invalid adjacency matrix in CSV file");
+        }
+        if (std::getline(in, line)) throw std::runtime_error("Invalid adjacency matrix in CSV file");
+        out.close();
+        if (!out) throw std::runtime_error("Cannot write spill file " + path);
+
+        if (symmetric) return DistanceMatrix::fromTriangle(n, std::move(lower),
+                                                           plan.rowCacheRows, policy);
+        lower = std::vector<double>();
+        mirrors = std::vector<uint64_t>();
+        // The mapping keeps the file's pages after the name is removed
+        return DistanceMatrix::mapFile(path, plan.rowCacheRows, policy);
+    }
+
+    /**
+     * @brief Builds the k-nearest-neighbour list of every city
+     * @param k Number of neighbours kept per city
+     * @return Lists sorted by distance, k entries per city
+     *
+     * This is the only full pass over the matrix, so a mapped matrix is read with
+     * sequential readahead here and switched back to random access afterwards.
+     */
+    NeighborLists buildNeighborLists(int k) const {
+        int n = static_cast<int>(matrix_.size());
+        k = std::max(0, std::min(k, n - 1));
+        NeighborLists lists(n);
+        matrix_.advise(DistanceMatrix::Access::Sequential);
+        #pragma omp parallel
+        {
+            std::vector<int> order(n);
+            #pragma omp for schedule(static)
+            for (int a = 0; a < n; ++a) {
+                nearestNeighbors(matrix_[a], a, k, order, lists[a]);
+            }
+        }
+        matrix_.advise(DistanceMatrix::Access::Random);
+        return lists;
+    }
+
+    /**
+     * @brief The k cities closest to city a, closest first
+     * @param row Distances from a
+     * @param a City the row belongs to (excluded from its own list)
+     * @param k List size, at most n - 1
+     * @param order Scratch space of n entries
+     * @param list Output
+     */
+    static void nearestNeighbors(const double* row, int a, int k, std::vector<int>& order,
+                                 std::vector<int>& list) {
+        int n = static_cast<int>(order.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::swap(order[a], order[n - 1]); // Exclude the city itself
+        std::partial_sort(order.begin(), order.begin() + k, order.end() - 1,
+                          [&row](int x, int y) { return row[x] < row[y]; });
+        list.assign(order.begin(), order.begin() + k);
+    }
+};
+
+/**
+ * @class CancellationToken
+ * @brief Flag an embedding service raises to stop a running solve
+ *
+ * Copies share one flag, so the caller keeps a copy and hands another to the
+ * solver through SearchOptions. Raising it is a single atomic store and the
+ * search checks it before every move, so a solve stops within one move
+ * instead of one cancel poll; the best tour so far is returned.
+ */
+class CancellationToken {
+public:
+    CancellationToken() : flag_(std::make_shared<std::atomic<bool>>(false)) {}
+
+    /**
+     * @brief Asks every solve holding a copy of this token to stop
+     */
+    void cancel() const { flag_->store(true, std::memory_order_relaxed); }
+
+    bool cancelled() const { return flag_->load(std::memory_order_relaxed); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> flag_;
+};
+
+/**
+ * @struct SearchProgress
+ * @brief State of a running solve as passed to the progress callback
+ */
+struct SearchProgress {
+    double best = 0.0;           ///< Shortest tour seen so far, running descents included
+    double elapsedSeconds = 0.0; ///< Since the solve started
+    int restartsDone = 0;        ///< Restarts finished
+    int restartsTotal = 0;       ///< Restarts requested
+};
+
+/**
+ * @struct SearchOptions
+ * @brief Local search configuration selected on the command line
+ */
+struct SearchOptions {
+    std::vector<MoveOperator> chain{MoveOperator::TwoOpt}; ///< VND order, cheapest first
+    bool adaptiveOrder = false; ///< Re-rank the chain by evaluations per unit of gain
+    int neighborListSize = 8;   ///< Candidate neighbours per city (used by lk, or3opt and 2optnl)
+    int maxSegmentLength = 3;   ///< Longest segment moved by or3opt
+    int windowWidth = 6;        ///< Window k of bs: no city passes one k or more positions away
+    int lnsRemove = 0;          ///< LNS: cities removed per attempt (0: n / 20, within 5..60)
+    bool regretRepair = true;   ///< LNS: reinsert by regret-2 rather than cheapest insertion
+    bool lnsPolish = false;     ///< LNS: run the VND chain on every repaired tour
+    bool printStats = false;    ///< Report per-operator statistics on stderr
+    bool multilevel = false;    ///< Solve through recursive coarsening (see solveMultilevel)
+    int coarsestSize = 100;     ///< Stop coarsening once the instance has at most this many nodes
+    InitStrategy init = InitStrategy::Random; ///< Starting tour of each restart
+    double maxEdgeOverlap = 0.5; ///< Diverse init: max fraction of edges reused from explored tours
+    double perturbation = 0.1;   ///< Diverse init: probability of not taking the nearest city
+    Engine engine = Engine::Auto; ///< Solution strategy (Auto runs the planner)
+    int threads = 0;              ///< Thread count, 0 lets the planner decide
+    int interleave = 4;           ///< Interleaved engine: descents in flight per thread
+    bool quantize = false;        ///< Prescreen 2-opt candidates on an 8-bit matrix copy
+    std::string inputFile;        ///< Read line 1 and the CSV from this file (plain, gzip or zstd)
+    std::string matrixFile;       ///< Binary matrix to map instead of reading CSV from stdin
+    std::string convertFile;      ///< Write the CSV from stdin to this binary file and exit
+    std::string publishName;      ///< Copy the CSV matrix into this shared-memory segment and exit
+    std::string attachName;       ///< Shared-memory segment to attach instead of reading CSV
+    std::string unpublishName;    ///< Remove this shared-memory segment and exit
+    size_t rowCacheRows = 0;      ///< Mapped matrix: rows cached per thread (0 disables)
+    RowCache::Policy rowCachePolicy = RowCache::Policy::Lru; ///< Row cache eviction order
+    std::string coordsFile;       ///< TSPLIB coordinate file, rows computed on demand
+    std::string subsetsFile;      ///< Solve each listed subset of the matrix instead of all cities
+    size_t gatherLimit = 0;       ///< Subsets up to this size are copied into a compact matrix
+    std::string jobsFile;         ///< Run the jobs listed in this file through a JobScheduler
+    size_t memoryLimit = 0;       ///< Plan representations to fit this many bytes (0: no limit)
+    bool memoryReport = false;    ///< Print the memory plan and peak RSS per phase
+    double timeLimit = 0.0;       ///< Cancel the search after this many seconds (0: no limit)
+    /// Called after every finished restart or, with progressInterval, at most that often
+    std::function<void(const SearchProgress&)> progress;
+    /// Minimum seconds between two progress reports; 0 reports exactly once per restart.
+    /// Reports may then also come from inside long descents; the last restart always reports.
+    double progressInterval = 0.0;
+    /// Polled during the search; returning true stops it and the best tour so far is returned
+    std::function<bool()> cancel;
+    /// Checked before every move; cancelling it stops the search like cancel does
+    CancellationToken cancelToken;
+    /// Called by every search thread at its preemption points; may block while more
+    /// urgent work uses the thread's core (see JobScheduler)
+    std::function<void()> preempt;
+    /// Called by a search thread that has no work left in the current parallel region:
+    /// its core may go to other work until the thread's next preemption point. Setting
+    /// it makes the restarts engine hand out restarts one at a time, seeded by index.
+    std::function<void()> release;
+};
+
+/**
+ * @struct TourState
+ * @brief Tour plus the bookkeeping needed for O(1) move evaluation
+ *
+ * fwd[k] is the length of the path tour[0] -> ... -> tour[k] and bwd[k] the length
+ * of the same path walked backwards, so the cost of reversing any segment is known
+ * in constant time even when the matrix is asymmetric.
+ */
+struct TourState {
+    std::vector<int> tour;    ///< City sequence (cyclic)
+    std::vector<int> pos;     ///< pos[city] = index of city in tour
+    std::vector<double> fwd;  ///< Prefix lengths in tour direction (size n + 1)
+    std::vector<double> bwd;  ///< Prefix lengths against tour direction (size n + 1)
+    double length = 0.0;      ///< Total closed tour length
+};
+
+/**
+ * @class TSPSolver
+ * @brief Parallel implementation of TSP solver using Shotgun Hill Climbing algorithm
+ * 
+ * This class implements a parallel version of the Traveling Salesman Problem solver
+ * using the Shotgun Hill Climbing heuristic with 2-opt local search optimization.
+ * The parallelization is achieved through OpenMP, distributing multiple restarts
+ * across available CPU threads to explore the solution space more efficiently.
+ * The problem data lives in a shared, immutable Instance; a TSPSolver is the
+ * state of one solve on it.
+ */
+class TSPSolver {
+public:
+    /**
+     * @brief Constructor that initializes the solver with a base seed
+     * @param seed Base seed for random number generation across threads
+     */
+    TSPSolver(unsigned seed)
+        : TSPSolver(Instance::fromCSV(std::cin), seed) {} // Load distance matrix from stdin
+
+    /**
+     * @brief Constructor for a solve on a shared instance
+     * @param instance Problem data; never modified, may be shared with concurrent solvers
+     * @param seed Base seed for random number generation across threads
+     *
+     * A solver holds only per-solve state (seed, options, statistics, tour
+     * bookkeeping). Run concurrent solves by giving each its own TSPSolver on the
+     * same instance; nothing instance-sized is copied.
+     */
+    TSPSolver(std::shared_ptr<const Instance> instance, unsigned seed)
+        : instance_(std::move(instance)), adjacencyMatrix_(instance_->matrix()), baseSeed_(seed) {}
+
+    /**
+     * @brief Constructor for an instance that is already in memory
+     * @param matrix Square distance matrix, matrix[i][j] = distance from city i to city j
+     * @param seed Base seed for random number generation across threads
+     * @throws std::runtime_error if the matrix is empty or not square
+     */
+    TSPSolver(const std::vector<std::vector<double>>& matrix, unsigned seed)
+        : TSPSolver(DistanceMatrix::fromRows(matrix), seed) {}
+
+    /**
+     * @brief Constructor for an owned or file-mapped matrix
+     * @param matrix Square distance matrix
+     * @param seed Base seed for random number generation across threads
+     * @throws std::runtime_error if the matrix is empty
+     */
+    TSPSolver(DistanceMatrix matrix, unsigned seed)
+        : TSPSolver(std::make_shared<const Instance>(std::move(matrix)), seed) {}
+
+    /**
+     * @brief The instance's distance matrix
+     */
+    const DistanceMatrix& distanceMatrix() const {
+        return adjacencyMatrix_;
+    }
+
+    /**
+     * @brief The shared instance this solver works on
+     */
+    const std::shared_ptr<const Instance>& instance() const {
+        return instance_;
+    }
+
+    /**
+     * @brief Main solving method that orchestrates the parallel TSP solving process
+     * @param numIterations Maximum iterations per hill climbing run
+     * @param numRestarts Total number of random restarts to perform
+     * @return Best tour found as a vector of city indices
+     */
+    std::vector<int> solveTSP(int numIterations, int numRestarts) {
+        return solveTSP(numIterations, numRestarts, planExecution(numIterations, numRestarts));
+    }
+
+    /**
+     * @brief Solves with an explicit engine and thread count
+     * @param numIterations Maximum iterations per hill climbing run
+     * @param numRestarts Total number of random restarts to perform
+     * @param plan Engine and threads, usually from planExecution
+     * @return Best tour found as a vector of city indices
+     */
+    std::vector<int> solveTSP(int numIterations, int numRestarts, const ExecutionPlan& plan) {
+        omp_set_num_threads(plan.threads);
+        stopRequested_.store(options_.cancelToken.cancelled());
+        restartsDone_.store(0);
+        restartsTotal_ = numRestarts;
+        progressBest_.store(std::numeric_limits<double>::max());
+        solveStart_ = omp_get_wtime();
+        lastProgress_.store(solveStart_);
+        if (options_.multilevel) {
+            return solveMultilevel(numIterations, numRestarts);
+        }
+        switch (plan.engine) {
+            case Engine::Exact:
+                return solveExact();
+            case Engine::IntraRestart:
+                return shotgunHillClimbingIntraRestart(numIterations, numRestarts);
+            case Engine::Nested:
+                return shotgunHillClimbingNested(numIterations, numRestarts);
+            case Engine::Interleaved:
+                return shotgunHillClimbingInterleaved(numIterations, numRestarts);
+            case Engine::Lanes:
+                return shotgunHillClimbingLanes(numIterations, numRestarts);
+            case Engine::Lns:
+                return largeNeighborhoodSearch(numIterations, numRestarts);
+            default:
+                return shotgunHillClimbingParallel(numIterations, numRestarts);
+        }
+    }
+
+    /**
+     * @brief Solves the tour over a subset of this instance's cities
+     * @param cities Master index of each city to visit (distinct)
+     * @param numIterations Maximum iterations per hill climbing run
+     * @param numRestarts Total number of random restarts to perform
+     * @param gather Copy the subset into a compact matrix instead of reading through a view
+     * @return Best tour found, as master city indices starting at cities[0]
+     * @throws std::runtime_error if the city list is empty or invalid
+     *
+     * The subset is solved by a nested solver with this solver's options and its
+     * own plan, so many small subsets can share one loaded master matrix. Operator
+     * statistics of every subset solve are added to this solver's totals.
+     */
+    std::vector<int> solveSubset(const std::vector<int>& cities, int numIterations,
+                                 int numRestarts, bool gather) {
+        // The lanes engine reads one contiguous block, which a view does not have
+        bool compact = gather || options_.engine == Engine::Lanes;
+        TSPSolver subset(compact ? DistanceMatrix::gather(adjacencyMatrix_, cities)
+                                 : DistanceMatrix::view(adjacencyMatrix_, cities,
+                                                        options_.rowCacheRows,
+                                                        options_.rowCachePolicy),
+                         baseSeed_);
+        subset.configureSearch(options_);
+        std::vector<int> tour = subset.solveTSP(numIterations, numRestarts);
+
+        if (operatorStats_.size() != options_.chain.size()) {
+            operatorStats_.assign(options_.chain.size(), OperatorStats{});
+        }
+        const std::vector<OperatorStats>& subsetStats = subset.operatorStats();
+        for (size_t k = 0; k < subsetStats.size() && k < operatorStats_.size(); ++k) {
+            operatorStats_[k] += subsetStats[k];
+        }
+        for (int& city : tour) city = cities[city];
+        return tour;
+    }
+
+    /**
+     * @brief Chooses the engine and thread count for a solve
+     * @param numIterations Maximum iterations per hill climbing run
+     * @param numRestarts Total number of restarts
+     * @return Plan honouring --engine / --threads when given, planned otherwise
+     *
+     * The planner predicts the wall time of every engine for every thread count
+     * with a simple cost model and keeps the cheapest one. Its two constants, the
+     * fork/join cost of a parallel region and the cost of one move evaluation, are
+     * measured on this machine and this instance by calibrate(). Typical results:
+     * a 3-city instance is solved exactly on one thread (forking would cost more
+     * than the whole search), while a few hundred cities with many restarts use
+     * every core for independent restarts.
+     */
+    ExecutionPlan planExecution(int numIterations, int numRestarts) const {
+        int cores = options_.threads > 0 ? options_.threads : omp_get_max_threads();
+        int n = static_cast<int>(adjacencyMatrix_.size());
+        ExecutionPlan plan;
+
+        if (options_.engine != Engine::Auto) {
+            plan.engine = options_.engine;
+            plan.threads = options_.engine == Engine::Exact ||
+                           options_.engine == Engine::Sequential ? 1 : cores;
+            if (plan.engine == Engine::Exact && n > kMaxExactCities) {
+                throw std::runtime_error("Exact engine supports at most " +
+                                         std::to_string(kMaxExactCities) + " cities");
+            }
+            if (plan.engine == Engine::Lanes && n > kLaneMaxCities) {
+                throw std::runtime_error("SIMD lanes engine supports at most " +
+                                         std::to_string(kLaneMaxCities) + " cities");
+            }
+            if (plan.engine == Engine::Lanes && !adjacencyMatrix_.data() &&
+                !adjacencyMatrix_.typedData()) {
+                throw std::runtime_error("SIMD lanes engine needs a stored matrix");
+            }
+            return plan;
+        }
+        if (n <= 3) {
+            // Every tour has the same length up to orientation
+            plan.engine = Engine::Exact;
+            return plan;
+        }
+
+        Calibration c = calibrate();
+        double moves = std::min<double>(numIterations, 3.0 * n); // Improving moves per descent
+        double scanSeconds = n * static_cast<double>(n) / 6.0 * c.evalSeconds; // First-improvement scan
+        double restartSeconds = moves * scanSeconds;
+
+        plan.engine = Engine::Sequential;
+        plan.estimatedSeconds = numRestarts * restartSeconds;
+        auto consider = [&plan](Engine engine, int threads, double seconds) {
+            // Extra threads must pay for themselves by a clear margin
+            if (seconds < 0.95 * plan.estimatedSeconds) {
+                plan = ExecutionPlan{engine, threads, seconds};
+            }
+        };
+        for (int t = 2; t <= cores; ++t) {
+            int rounds = (numRestarts + t - 1) / t;
+            consider(Engine::ParallelRestarts, t, rounds * restartSeconds + c.forkJoinSeconds);
+        }
+        for (int t = 2; t <= cores; ++t) {
+            consider(Engine::IntraRestart, t,
+                     numRestarts * moves * (scanSeconds / t + c.forkJoinSeconds));
+        }
+        if (numRestarts < cores && n >= kTaskScanCities) {
+            // Concurrent restarts share the spare threads through scan sub-tasks
+            double width = static_cast<double>(cores) / numRestarts;
+            consider(Engine::Nested, cores,
+                     moves * (scanSeconds / width + c.forkJoinSeconds) + c.forkJoinSeconds);
+        }
+        if (n <= kMaxExactCities) {
+            // The optimum is worth a little extra time over the heuristic
+            double exactSeconds = std::ldexp(1.0, n - 1) * n * n * c.evalSeconds;
+            if (exactSeconds <= std::max(plan.estimatedSeconds, kExactTimeBudget)) {
+                plan = ExecutionPlan{Engine::Exact, 1, exactSeconds};
+            }
+        }
+        return plan;
+    }
+
+    /**
+     * @brief True if a search with these options reads candidate neighbour lists
+     */
+    static bool usesNeighborLists(const SearchOptions& options) {
+        return options.init == InitStrategy::Diverse || options.engine == Engine::Lns ||
+               std::any_of(options.chain.begin(), options.chain.end(), [](MoveOperator op) {
+                   return op == MoveOperator::LinKernighan ||
+                          op == MoveOperator::SegmentInsertion ||
+                          op == MoveOperator::TwoOptNeighbors;
+               });
+    }
+
+    /**
+     * @brief Instance tables a search with these options will request
+     *
+     * Pass to Instance::fromCSV so they are built while the matrix is loading.
+     */
+    static Preprocessing preprocessingFor(const SearchOptions& options) {
+        Preprocessing preprocessing;
+        if (usesNeighborLists(options) || options.multilevel) {
+            preprocessing.neighborListSize = options.neighborListSize;
+        }
+        preprocessing.quantize = options.quantize;
+        return preprocessing;
+    }
+
+    /// Widest bs window (--bs-width): the DP keeps 2^(k-1) * 2k states per position
+    static constexpr int kMaxWindowWidth = 10;
+
+    /**
+     * @brief Memory budget of a search with these options, for MemoryBudget::plan
+     */
+    static MemoryBudget memoryBudget(const SearchOptions& options) {
+        MemoryBudget budget;
+        budget.limitBytes = options.memoryLimit;
+        budget.threads = options.threads > 0 ? options.threads : omp_get_max_threads();
+        budget.rowCacheRows = options.rowCacheRows;
+        budget.rowCachePolicy = options.rowCachePolicy;
+        budget.tables = preprocessingFor(options);
+        budget.edgeBitmap = options.init == InitStrategy::Diverse;
+        return budget;
+    }
+
+    /**
+     * @brief Selects the local search operators and their order
+     * @param options Operator chain and related settings
+     */
+    void configureSearch(const SearchOptions& options) {
+        options_ = options;
+    }
+
+    /**
+     * @brief Per-operator statistics accumulated over the last solve, in chain order
+     */
+    const std::vector<OperatorStats>& operatorStats() const {
+        return operatorStats_;
+    }
+
+    /**
+     * @brief True if the last solve was stopped early by the cancel callback
+     */
+    bool cancelled() const {
+        return stopRequested_.load();
+    }
+
+    /**
+     * @brief Operator chain the statistics refer to
+     */
+    const std::vector<MoveOperator>& operatorChain() const {
+        return options_.chain;
+    }
+
+    /**
+     * @brief Calculates the total length/cost of a given tour
+     * @param tour Vector representing the sequence of cities to visit
+     * @return Total distance of the tour
+     */
+    double calculateTourLength(const std::vector<int>& tour) const {
+        double length = 0.0;
+        // Sum distances between consecutive cities + return to start
+        for (size_t i = 0; i < tour.size(); ++i) {
+            length += adjacencyMatrix_[tour[i]][tour[(i + 1) % tour.size()]];
+        }
+        return length;
+    }
+
+    /**
+     * @brief 2-opt / Or-opt descent of one tour under any distance policy
+     * @param distance Policy such as FunctionDistance{[&](int a, int b) { ... }}
+     * @param tour Starting tour over cities 0..n-1; its first city stays first
+     * @param numIterations Maximum number of improving moves
+     * @return Pair of (improved tour, tour length)
+     *
+     * Needs no Instance: every distance comes from the policy, inlined into the
+     * scans, so a caller-defined metric runs as fast as a stored matrix.
+     */
+    template <typename Distance>
+    static std::pair<std::vector<int>, double> descend(const Distance& distance,
+                                                       std::vector<int> tour, int numIterations) {
+        TourState state;
+        state.tour = std::move(tour);
+        state.pos.resize(state.tour.size());
+        refreshTourState(distance, state);
+        OperatorStats stats;
+        for (int iter = 0; iter < numIterations && state.tour.size() >= 3; ++iter) {
+            if (!tryTwoOpt(distance, state, stats) && !tryOrOpt(distance, state, stats)) break;
+        }
+        return {state.tour, state.length};
+    }
+
+private:
+    std::shared_ptr<const Instance> instance_; ///< Shared read-only problem data
+    const DistanceMatrix& adjacencyMatrix_; ///< Distance matrix between cities (owned by instance_)
+    unsigned baseSeed_; ///< Base seed for generating unique seeds per thread
+    SearchOptions options_; ///< Local search configuration
+    std::vector<OperatorStats> operatorStats_; ///< Aggregated statistics, one per chain entry
+    std::shared_ptr<const NeighborLists> neighborLists_; ///< Nearest neighbours of each city (from instance_)
+    std::unique_ptr<EdgeUsageBitmap> edgeUsage_; ///< Edges of explored tours (diverse init only)
+
+    /// Minimum gain for a move to count as an improvement (absorbs rounding noise).
+    /// The original solver recomputed the whole tour per candidate and took any
+    /// smaller sum, rounding noise included; judging prefix-sum deltas against this
+    /// threshold instead changes which local optimum a descent ends in, so tours
+    /// differ from that version's for the same seed (not systematically better or worse).
+    static constexpr double kImprovementEpsilon = 1e-9;
+
+    /// Largest instance the Held-Karp engine accepts (memory grows as n * 2^n)
+    static constexpr int kMaxExactCities = 20;
+
+    /// Predicted time under which the planner prefers the exact engine to the heuristics
+    static constexpr double kExactTimeBudget = 0.05;
+
+    /// Smallest instance whose 2-opt scans the Nested engine splits into sub-tasks
+    static constexpr int kTaskScanCities = 200;
+
+    /// Rows of the 2-opt scan per sub-task in the Nested engine
+    static constexpr int kRowsPerTask = 16;
+
+    /**
+     * @enum ScanMode
+     * @brief How the 2-opt operator walks its neighbourhood
+     */
+    enum class ScanMode {
+        Serial,   ///< Single thread
+        Parallel, ///< Worksharing loop over all threads (IntraRestart engine)
+        Tasks     ///< Sub-tasks stolen by idle threads while restarts are scarce (Nested engine)
+    };
+
+    ScanMode scanMode_ = ScanMode::Serial; ///< Set by the engine for the duration of a solve
+    std::atomic<int> unfinishedRestarts_{0}; ///< Restarts not yet completed (Nested engine)
+
+    mutable std::atomic<bool> stopRequested_{false}; ///< Set once the callback or token said stop
+    std::atomic<int> restartsDone_{0}; ///< Restarts finished in the current solve
+    int restartsTotal_ = 0;            ///< Restarts requested for the current solve
+    mutable std::atomic<double> progressBest_{0.0};  ///< Shortest tour seen in the current solve
+    double solveStart_ = 0.0;                        ///< omp_get_wtime() when the solve started
+    mutable std::atomic<double> lastProgress_{0.0};  ///< Time of the last progress report
+
+    /// Improving moves between two polls of the cancel callback (and preemption points)
+    static constexpr int kCancelPollMoves = 64;
+
+    /// Interleaved engine: round-robin rounds between two polls of the cancel callback
+    static constexpr long kCancelPollRounds = 4096;
+
+    /// Restarts run side by side by the Lanes engine (one per SIMD lane of doubles on AVX-512)
+    static constexpr int kLanes = 8;
+
+    /// Largest instance for the Lanes engine: its flat matrix should stay in L2
+    static constexpr int kLaneMaxCities = 512;
+
+    std::shared_ptr<const QuantizedMatrix> quantized_; ///< 8-bit prescreen copy (--quantize only)
+
+    /// Candidates bounded at once by the quantized 2-opt prescreen
+    static constexpr int kPrescreenBlock = 64;
+
+    /**
+     * @brief Exact solution by Held-Karp dynamic programming
+     * @return Optimal tour starting at city 0
+     *
+     * best[S][j] is the shortest path that starts at city 0, visits the cities of
+     * subset S (bit k stands for city k + 1) and ends at city j. O(n^2 2^n) time and
+     * O(n 2^n) memory, so it is only used for instances of a handful of cities.
+     * Works for asymmetric matrices. A stop request is polled every few thousand
+     * subsets; a stopped solve has no complete tour yet and returns 0, 1, ..., n-1.
+     */
+    std::vector<int> solveExact() const {
+        const auto& d = adjacencyMatrix_;
+        int n = static_cast<int>(d.size());
+        if (n <= 3) {
+            std::vector<int> tour(n);
+            std::iota(tour.begin(), tour.end(), 0);
+            if (n == 3 && d[0][2] + d[2][1] + d[1][0] < d[0][1] + d[1][2] + d[2][0]) {
+                std::swap(tour[1], tour[2]);
+            }
+            return tour;
+        }
+
+        int m = n - 1;
+        size_t subsets = size_t{1} << m;
+        const double inf = std::numeric_limits<double>::max();
+        std::vector<double> best(subsets * m, inf);
+        std::vector<int> parent(subsets * m, -1);
+        for (int j = 0; j < m; ++j) {
+            best[(size_t{1} << j) * m + j] = d[0][j + 1];
+        }
+        for (size_t set = 1; set < subsets; ++set) {
+            if ((set & 0xFFF) == 0 && pollCancel()) {
+                std::vector<int> tour(n);
+                std::iota(tour.begin(), tour.end(), 0);
+                return tour;
+            }
+            for (int j = 0; j < m; ++j) {
+                double base = best[set * m + j];
+                if (!(set >> j & 1) || base == inf) continue;
+                for (int k = 0; k < m; ++k) {
+                    if (set >> k & 1) continue;
+                    size_t next = (set | size_t{1} << k) * m + k;
+                    double length = base + d[j + 1][k + 1];
+                    if (length < best[next]) {
+                        best[next] = length;
+                        parent[next] = j;
+                    }
+                }
+            }
+        }
+
+        // Close the cycle and walk the parents back to city 0
+        size_t full = subsets - 1;
+        int last = 0;
+        for (int j = 1; j < m; ++j) {
+            if (best[full * m + j] + d[j + 1][0] < best[full * m + last] + d[last + 1][0]) last = j;
+        }
+        std::vector<int> tour;
+        for (size_t set = full; last >= 0; ) {
+            tour.push_back(last + 1);
+            int previous = parent[set * m + last];
+            set &= ~(size_t{1} << last);
+            last = previous;
+        }
+        tour.push_back(0);
+        std::reverse(tour.begin(), tour.end());
+        return tour;
+    }
+
+    /**
+     * @brief Generates a random permutation tour starting from city 0
+     * @param gen Random number generator for this thread
+     * @return Random tour as vector of city indices
+     */
+    std::vector<int> generateRandomTour(std::mt19937& gen) {
+        std::vector<int> tour(adjacencyMatrix_.size());
+        std::iota(tour.begin(), tour.end(), 0); // Fill with 0,1,2,...,n-1
+        std::shuffle(tour.begin() + 1, tour.end(), gen); // Keep city 0 fixed, shuffle rest
+        return tour;
+    }
+
+    /**
+     * @brief Builds the evaluation state (positions and prefix lengths) for a tour
+     * @param tour City sequence
+     * @return State ready for constant-time move evaluation
+     */
+    TourState makeTourState(std::vector<int> tour) const {
+        TourState state;
+        state.tour = std::move(tour);
+        state.pos.resize(state.tour.size());
+        refreshTourState(state);
+        return state;
+    }
+
+    /**
+     * @brief Calls kernel with the distance policy that matches the matrix
+     * @param kernel Generic callable taking the policy by const reference
+     * @return What kernel returns
+     *
+     * The one runtime branch in front of a templated kernel, taken once per call
+     * rather than once per entry. Dense and borrowed float32 / int32 blocks are
+     * read in place, triangles and coordinates entry by entry, views and
+     * row-cached mappings through their row caches.
+     */
+    template <typename Kernel>
+    decltype(auto) withDistance(Kernel&& kernel) const {
+        using Metric = Coordinates::Metric;
+        const DistanceMatrix& matrix = adjacencyMatrix_;
+        if (const Coordinates* coordinates = matrix.coordinates()) {
+            switch (coordinates->metric()) {
+                case Metric::Euclidean:
+                    return kernel(CoordinateDistance<Metric::Euclidean>{coordinates});
+                case Metric::Ceiling:
+                    return kernel(CoordinateDistance<Metric::Ceiling>{coordinates});
+                case Metric::Att:
+                    return kernel(CoordinateDistance<Metric::Att>{coordinates});
+                case Metric::Geo:
+                    return kernel(CoordinateDistance<Metric::Geo>{coordinates});
+            }
+        }
+        if (const double* lower = matrix.triangle()) return kernel(TriangularDistance{lower});
+        if (matrix.typedData() || (matrix.data() && !matrix.hasRowCache())) {
+            return withStoredDistance(kernel);
+        }
+        return kernel(CachedDistance{&matrix});
+    }
+
+    /**
+     * @brief Calls kernel with the policy that reads a stored block in place
+     * @param kernel Generic callable taking the policy by const reference
+     * @return What kernel returns
+     *
+     * For borrowed float32 / int32 matrices and for matrices with data(), which
+     * the caller must have checked. The lanes engine, which has no row-cache
+     * variant, calls it directly.
+     */
+    template <typename Kernel>
+    decltype(auto) withStoredDistance(Kernel&& kernel) const {
+        const DistanceMatrix& matrix = adjacencyMatrix_;
+        if (const void* typed = matrix.typedData()) {
+            if (matrix.element() == DistanceMatrix::Element::Float32) {
+                return kernel(TypedDistance<float>{static_cast<const float*>(typed),
+                                                   matrix.rowStride()});
+            }
+            return kernel(TypedDistance<int32_t>{static_cast<const int32_t*>(typed),
+                                                 matrix.rowStride()});
+        }
+        return kernel(DenseDistance{matrix.data(), matrix.rowStride()});
+    }
+
+    /**
+     * @brief Recomputes positions and prefix lengths after the tour was modified
+     * @param state Tour state to refresh in place
+     */
+    void refreshTourState(TourState& state) const {
+        withDistance([&state](const auto& distance) { refreshTourState(distance, state); });
+    }
+
+    /**
+     * @brief Recomputes positions and prefix lengths under a distance policy
+     * @param distance Distance policy
+     * @param state Tour state to refresh in place
+     *
+     * Costs O(n), which is negligible next to the O(n^2) neighbourhood scan that
+     * precedes every accepted move.
+     */
+    template <typename Distance>
+    static void refreshTourState(const Distance& distance, TourState& state) {
+        const std::vector<int>& tour = state.tour;
+        size_t n = tour.size();
+        state.fwd.assign(n + 1, 0.0);
+        state.bwd.assign(n + 1, 0.0);
+        for (size_t k = 0; k < n; ++k) {
+            int a = tour[k];
+            int b = tour[(k + 1) % n];
+            state.pos[a] = static_cast<int>(k);
+            state.fwd[k + 1] = state.fwd[k] + distance(a, b);
+            state.bwd[k + 1] = state.bwd[k] + distance(b, a);
+        }
+        state.length = state.fwd[n];
+    }
+
+    /**
+     * @brief Refresh through a row cache: entries are read one by one (at), so the
+     *        refresh does not fetch every row of the tour for two entries each
+     */
+    static void refreshTourState(const CachedDistance& distance, TourState& state) {
+        const DistanceMatrix& matrix = *distance.matrix;
+        refreshTourState(FunctionDistance{[&matrix](int a, int b) { return matrix.at(a, b); }},
+                         state);
+    }
+
+    /**
+     * @brief Cost change of reversing the cyclic segment tour[s..e]
+     * @param state Current tour state
+     * @param s First position of the segment
+     * @param e Last position of the segment (may wrap around past n - 1)
+     * @return New length minus old length
+     *
+     * The edges entering and leaving the segment are swapped and the interior is
+     * walked backwards, whose cost comes from the bwd prefix sums.
+     */
+    double reversalDelta(const TourState& state, int s, int e) const {
+        return reversalDelta(CachedDistance{&adjacencyMatrix_}, state, s, e);
+    }
+
+    /**
+     * @brief reversalDelta under a distance policy
+     */
+    template <typename Distance>
+    static double reversalDelta(const Distance& distance, const TourState& state, int s, int e) {
+        const std::vector<int>& tour = state.tour;
+        int n = static_cast<int>(tour.size());
+        int a = tour[(s - 1 + n) % n];
+        int b = tour[s];
+        int c = tour[e];
+        int d = tour[(e + 1) % n];
+        double forward, backward;
+        if (s <= e) {
+            forward = state.fwd[e] - state.fwd[s];
+            backward = state.bwd[e] - state.bwd[s];
+        } else {
+            forward = state.fwd[n] - state.fwd[s] + state.fwd[e];
+            backward = state.bwd[n] - state.bwd[s] + state.bwd[e];
+        }
+        return distance(a, c) + backward + distance(b, d)
+             - distance(a, b) - forward - distance(c, d);
+    }
+
+    /**
+     * @brief Measures the planner's machine constants
+     * @return Fork/join cost and per-evaluation cost on this instance
+     *
+     * Takes a few milliseconds: a batch of empty parallel regions and a bounded
+     * 2-opt scan over a random tour of the loaded matrix.
+     */
+    Calibration calibrate() const {
+        Calibration c;
+        constexpr int kRegions = 50;
+        double start = omp_get_wtime();
+        for (int k = 0; k < kRegions; ++k) {
+            #pragma omp parallel
+            {
+                volatile int id = omp_get_thread_num(); // Keep the region from being elided
+                (void)id;
+            }
+        }
+        c.forkJoinSeconds = (omp_get_wtime() - start) / kRegions;
+
+        std::mt19937 gen(baseSeed_);
+        TourState state = makeTourState(const_cast<TSPSolver*>(this)->generateRandomTour(gen));
+        int n = static_cast<int>(state.tour.size());
+        constexpr long long kMaxEvaluations = 200000;
+        // Behind a row cache nearly every evaluation fetches a row of n entries
+        long long maxEvaluations = adjacencyMatrix_.hasRowCache()
+            ? std::max(1000LL, kMaxEvaluations / std::max(n, 1)) : kMaxEvaluations;
+        long long evaluations = 0;
+        double sink = 0.0;
+        start = omp_get_wtime();
+        withDistance([&](const auto& distance) { // Timed under the policy the kernels use
+            for (int i = 1; i < n - 1 && evaluations < maxEvaluations; ++i) {
+                for (int j = i + 1; j < n && evaluations < maxEvaluations; ++j, ++evaluations) {
+                    sink += reversalDelta(distance, state, i, j);
+                }
+            }
+        });
+        double elapsed = omp_get_wtime() - start;
+        c.evalSeconds = evaluations > 0 ? elapsed / evaluations : 0.0;
+        if (sink == std::numeric_limits<double>::max()) c.evalSeconds *= 2; // Keep sink alive
+        return c;
+    }
+
+    /**
+     * @brief Builds a perturbed greedy tour that avoids edges of tours already explored
+     * @param gen Random number generator for this thread
+     * @return Tour starting at city 0
+     *
+     * Nearest-neighbour construction from city 0 over the candidate lists. An edge
+     * already present in the usage bitmap is taken only while the share of reused
+     * edges stays under maxEdgeOverlap (or when no fresh candidate is left); with
+     * probability perturbation a random allowed candidate replaces the nearest one.
+     * Restarts therefore start in different regions instead of re-entering the same
+     * basins, as independent uniform permutations often do.
+     */
+    std::vector<int> generateDiverseTour(std::mt19937& gen) {
+        const auto& d = adjacencyMatrix_;
+        int n = static_cast<int>(d.size());
+        std::vector<int> tour{0};
+        std::vector<bool> visited(n, false);
+        visited[0] = true;
+        std::uniform_real_distribution<double> coin(0.0, 1.0);
+        std::vector<int> allowed, blocked;
+        int overlap = 0;
+
+        for (int step = 1; step < n; ++step) {
+            int current = tour.back();
+            bool mayReuse = overlap < options_.maxEdgeOverlap * step;
+            allowed.clear();
+            blocked.clear();
+            for (int c : (*neighborLists_)[current]) {
+                if (visited[c]) continue;
+                bool reuse = !mayReuse && edgeUsage_->test(current, c);
+                (reuse ? blocked : allowed).push_back(c);
+            }
+            if (allowed.empty()) allowed.swap(blocked); // Overlap budget spent but no fresh edge left
+
+            int next;
+            if (allowed.empty()) {
+                // All candidates visited: fall back to the nearest unvisited city
+                next = -1;
+                for (int c = 0; c < n; ++c) {
+                    if (!visited[c] && (next < 0 || d[current][c] < d[current][next])) next = c;
+                }
+            } else if (coin(gen) < options_.perturbation) {
+                next = allowed[std::uniform_int_distribution<size_t>(0, allowed.size() - 1)(gen)];
+            } else {
+                next = allowed.front(); // Lists are sorted by distance
+            }
+
+            if (edgeUsage_->test(current, next)) ++overlap;
+            visited[next] = true;
+            tour.push_back(next);
+        }
+        return tour;
+    }
+
+    /**
+     * @brief Starting tour of one restart according to the configured strategy
+     */
+    std::vector<int> generateInitialTour(std::mt19937& gen) {
+        if (options_.init == InitStrategy::Diverse && adjacencyMatrix_.size() > 3) {
+            return generateDiverseTour(gen);
+        }
+        return generateRandomTour(gen);
+    }
+
+    /**
+     * @brief Performs 2-opt swap operation on a tour
+     * @param state Tour to modify in place
+     * @param i Start index of the segment to reverse
+     * @param j End index of the segment to reverse
+     *
+     * 2-opt removes two edges and reconnects the tour in a different way,
+     * effectively reversing a segment of the tour to eliminate edge crossings
+     */
+    void twoOptSwap(TourState& state, int i, int j) const {
+        withDistance([&](const auto& distance) { twoOptSwap(distance, state, i, j); });
+    }
+
+    /**
+     * @brief twoOptSwap under a distance policy
+     */
+    template <typename Distance>
+    static void twoOptSwap(const Distance& distance, TourState& state, int i, int j) {
+        std::reverse(state.tour.begin() + i, state.tour.begin() + j + 1); // Reverse segment [i,j]
+        refreshTourState(distance, state);
+    }
+
+    /**
+     * @brief Applies the best Balas-Simonetti reordering of the tour
+     * @param distance Distance policy
+     * @param state Current tour, updated if a better order exists
+     * @param stats Counters for this operator
+     * @param k Window width (2..kMaxWindowWidth)
+     * @return True if the tour was improved
+     *
+     * Searches every order of the cities in which a city never passes another
+     * that stood k or more positions away, i.e. city i precedes city j whenever
+     * j >= i + k, with city 0 kept first. That neighbourhood holds all 2-opt
+     * moves on segments shorter than k, all Or-opt moves over fewer than k
+     * positions and any combination of such moves along the tour, and the DP
+     * finds its optimum exactly in O(n k^2 2^k), linear in n.
+     *
+     * The tour slots are filled left to right. The placed positions are always
+     * 1..m-1 plus a subset of m+1..m+k-1, where m is the first position not yet
+     * placed, so a state is (m, that subset as k-1 bits, last placed position,
+     * which lies in m-k..m+k-1). Costs of levels m..m+k live in a ring; only a
+     * byte per state is kept for every level, to walk the best order back.
+     * Appending a position takes the cheapest of the 2k predecessors through a
+     * small window of distances read once per level.
+     */
+    template <typename Distance>
+    static bool tryBalasSimonetti(const Distance& distance, TourState& state,
+                                 OperatorStats& stats, int k) {
+        const std::vector<int>& tour = state.tour;
+        int n = static_cast<int>(tour.size());
+        int last = n - 1; // Positions 1..last are reordered, tour[0] stays first
+        k = std::max(2, std::min({k, last, kMaxWindowWidth}));
+        if (n < 4) return false;
+
+        constexpr double kInf = std::numeric_limits<double>::infinity();
+        int masks = 1 << (k - 1); // Placed subset of positions m+1..m+k-1
+        int lasts = 2 * k;        // Last placed position m-k+l for l in 0..2k-1
+        size_t level = static_cast<size_t>(masks) * lasts;
+        std::vector<double> cost(static_cast<size_t>(k + 1) * level, kInf);
+        std::vector<int8_t> parent(static_cast<size_t>(last + 2) * level);
+        std::vector<double> window(static_cast<size_t>(lasts) * k); // [l][jj]: m-k+l -> m+jj
+        auto costs = [&](int m) { return cost.data() + static_cast<size_t>(m % (k + 1)) * level; };
+
+        costs(1)[k - 1] = 0.0; // Nothing placed yet, the tour so far ends at position 0
+        long long evaluations = 0;
+        for (int m = 1; m <= last; ++m) {
+            for (int l = 0; l < lasts; ++l) {
+                int p = m - k + l;
+                for (int jj = 0; jj < k; ++jj) {
+                    int q = m + jj;
+                    window[l * k + jj] = p >= 0 && p <= last && q <= last
+                                       ? distance(tour[p], tour[q]) : 0.0;
+                }
+            }
+
+            double* from = costs(m);
+            for (int mask = 0; mask < masks; ++mask) {
+                const double* source = from + static_cast<size_t>(mask) * lasts;
+                for (int jj = 0; jj < k && m + jj <= last; ++jj) {
+                    if (jj > 0 && (mask >> (jj - 1) & 1)) continue; // Already placed
+                    double best = kInf;
+                    int bestLast = 0;
+                    for (int l = 0; l < lasts; ++l) {
+                        double value = source[l] + window[l * k + jj];
+                        if (value < best) {
+                            best = value;
+                            bestLast = l;
+                        }
+                    }
+                    if (best == kInf) continue;
+                    evaluations += lasts;
+
+                    // Placing m itself moves the frontier past the run of placed positions
+                    int nextM = m;
+                    int nextMask = mask | (jj > 0 ? 1 << (jj - 1) : 0);
+                    if (jj == 0) {
+                        int run = 0;
+                        while (mask >> run & 1) ++run;
+                        nextM = m + 1 + run;
+                        nextMask = mask >> (run + 1);
+                    }
+                    size_t index = static_cast<size_t>(nextMask) * lasts + (m + jj - nextM + k);
+                    double* to = costs(nextM);
+                    if (best < to[index]) {
+                        to[index] = best;
+                        parent[static_cast<size_t>(nextM) * level + index] =
+                            static_cast<int8_t>(bestLast);
+                    }
+                }
+            }
+            std::fill(from, from + level, kInf); // Reused as level m + k + 1
+        }
+
+        // Close the tour back to position 0
+        const double* done = costs(last + 1);
+        double best = kInf;
+        int l = 0;
+        for (int candidate = 0; candidate < lasts; ++candidate) {
+            int p = last + 1 - k + candidate;
+            if (p < 1 || done[candidate] == kInf) continue;
+            double value = done[candidate] + distance(tour[p], tour[0]);
+            if (value < best) {
+                best = value;
+                l = candidate;
+            }
+        }
+        stats.evaluations += evaluations;
+        if (!(best < state.length - kImprovementEpsilon)) return false;
+
+        std::vector<int> order(n);
+        order[0] = tour[0];
+        for (int slot = last, m = last + 1, mask = 0; slot >= 1; --slot) {
+            int p = m - k + l;
+            order[slot] = tour[p];
+            l = parent[static_cast<size_t>(m) * level + static_cast<size_t>(mask) * lasts + l];
+            if (p < m) { // p was the first unplaced position before it was placed
+                mask = ((1 << (m - p - 1)) - 1) | (mask << (m - p));
+                m = p;
+            } else {
+                mask &= ~(1 << (p - m - 1));
+            }
+        }
+        if (order == tour) return false; // Rounding: the DP sum differs from state.length
+
+        double before = state.length;
+        std::vector<int> previous = tour;
+        state.tour = std::move(order);
+        refreshTourState(distance, state);
+        if (state.length < before - kImprovementEpsilon) {
+            stats.gain += before - state.length;
+            return true;
+        }
+        state.tour = std::move(previous);
+        refreshTourState(distance, state);
+        return false;
+    }
+
+    /**
+     * @brief Balas-Simonetti through a row cache: the window reads single entries
+     *        (at) instead of fetching 2k rows per position
+     */
+    static bool tryBalasSimonetti(const CachedDistance& distance, TourState& state,
+                                 OperatorStats& stats, int k) {
+        const DistanceMatrix& matrix = *distance.matrix;
+        return tryBalasSimonetti(
+            FunctionDistance{[&matrix](int a, int b) { return matrix.at(a, b); }}, state, stats, k);
+    }
+
+    /**
+     * @brief Reverses a segment that may wrap around the end of the tour
+     * @param tour Tour to modify (positions are not refreshed)
+     * @param s First position of the segment
+     * @param length Number of cities in the segment
+     */
+    static void reverseCyclic(std::vector<int>& tour, int s, int length) {
+        int n = static_cast<int>(tour.size());
+        for (int k = 0; k < length / 2; ++k) {
+            std::swap(tour[(s + k) % n], tour[(s + length - 1 - k) % n]);
+        }
+    }
+
+    /**
+     * @brief Rotates the tour so that city 0 is first again and refreshes the state
+     *
+     * City 0 is searched for rather than read from pos, so the state may be stale.
+     */
+    void normalizeTour(TourState& state) const {
+        withDistance([&state](const auto& distance) { normalizeTour(distance, state); });
+    }
+
+    /**
+     * @brief normalizeTour under a distance policy
+     */
+    template <typename Distance>
+    static void normalizeTour(const Distance& distance, TourState& state) {
+        std::rotate(state.tour.begin(), std::find(state.tour.begin(), state.tour.end(), 0),
+                    state.tour.end());
+        refreshTourState(distance, state);
+    }
+
+    /**
+     * @brief Applies the first improving 2-opt move
+     * @param distance Distance policy
+     * @param state Current tour, updated if a move is applied
+     * @param stats Counters for this operator
+     * @return True if the tour was improved
+     */
+    template <typename Distance>
+    static bool tryTwoOpt(const Distance& distance, TourState& state, OperatorStats& stats) {
+        int n = static_cast<int>(state.tour.size());
+        for (int i = 1; i < n - 1; ++i) {
+            for (int j = i + 1; j < n; ++j) {
+                ++stats.evaluations;
+                double delta = reversalDelta(distance, state, i, j);
+
+                // Accept first improvement found (first-improvement strategy)
+                if (delta < -kImprovementEpsilon) {
+                    twoOptSwap(distance, state, i, j);
+                    stats.gain -= delta;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Applies the first improving 2-opt move whose new edge is a candidate-list edge
+     * @param state Current tour, updated if a move is applied
+     * @param stats Counters for this operator
+     * @return True if the tour was improved
+     *
+     * For every city a and each near neighbour c, the move adding a -> c (reverse
+     * succ(a) .. c) and the move adding c -> a (reverse c .. pred(a)) are evaluated.
+     * A neighbour list is sorted by distance, so the scan of a stops at the first c
+     * that is no closer than both tour edges at a: no later c can shorten the tour
+     * through a (exactly so on symmetric matrices). Each step reads O(n k) matrix
+     * entries instead of O(n^2), which keeps out-of-core instances off the disk.
+     * @param distance Distance policy
+     */
+    template <typename Distance>
+    bool tryTwoOptNeighbors(const Distance& distance, TourState& state,
+                            OperatorStats& stats) const {
+        int n = static_cast<int>(state.tour.size());
+        for (int p = 0; p < n; ++p) {
+            int a = state.tour[p];
+            int succ = state.tour[(p + 1) % n];
+            int pred = state.tour[(p - 1 + n) % n];
+            double succEdge = distance(a, succ);
+            double predEdge = distance(pred, a);
+            for (int c : (*neighborLists_)[a]) {
+                double toC = distance(a, c);
+                if (toC >= succEdge && toC >= predEdge) break;
+                int pc = state.pos[c];
+
+                // a -> c: reverse positions p+1 .. pc
+                int s = (p + 1) % n;
+                int length = (pc - s + n) % n + 1;
+                if (c != succ && length < n - 1) {
+                    ++stats.evaluations;
+                    double delta = reversalDelta(distance, state, s, pc);
+                    if (delta < -kImprovementEpsilon) {
+                        reverseCyclic(state.tour, s, length);
+                        normalizeTour(distance, state);
+                        stats.gain -= delta;
+                        return true;
+                    }
+                }
+
+                // c -> a: reverse positions pc .. p-1
+                int e = (p - 1 + n) % n;
+                length = (e - pc + n) % n + 1;
+                if (c != pred && length < n - 1) {
+                    ++stats.evaluations;
+                    double delta = reversalDelta(distance, state, pc, e);
+                    if (delta < -kImprovementEpsilon) {
+                        reverseCyclic(state.tour, pc, length);
+                        normalizeTour(distance, state);
+                        stats.gain -= delta;
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Parallel version of tryTwoOpt used inside a single restart
+     * @param distance Distance policy
+     * @param state Current tour, updated if a move is applied
+     * @param stats Counters for this operator
+     * @return True if the tour was improved
+     *
+     * Rows i of the scan are handed out dynamically. Each thread stops a row at its
+     * first improving j and publishes the row; rows after the earliest published one
+     * are skipped. The move applied is the one the sequential scan would pick, so
+     * results do not depend on the thread count.
+     */
+    template <typename Distance>
+    static bool tryTwoOptParallel(const Distance& distance, TourState& state,
+                                  OperatorStats& stats) {
+        int n = static_cast<int>(state.tour.size());
+        int firstRow = n;
+        int firstColumn = -1;
+        double firstDelta = 0.0;
+        long long evaluations = 0;
+
+        #pragma omp parallel for schedule(dynamic, 4) reduction(+:evaluations)
+        for (int i = 1; i < n - 1; ++i) {
+            int limit;
+            #pragma omp atomic read
+            limit = firstRow;
+            if (i > limit) continue; // An earlier row already has an improving move
+
+            for (int j = i + 1; j < n; ++j) {
+                ++evaluations;
+                double delta = reversalDelta(distance, state, i, j);
+                if (delta < -kImprovementEpsilon) {
+                    #pragma omp critical(two_opt_first_row)
+                    {
+                        if (i < firstRow) {
+                            firstRow = i;
+                            firstColumn = j;
+                            firstDelta = delta;
+                        }
+                    }
+                    break;
+                }
+            }
+        }
+
+        stats.evaluations += evaluations;
+        if (firstColumn < 0) return false;
+        twoOptSwap(distance, state, firstRow, firstColumn);
+        stats.gain -= firstDelta;
+        return true;
+    }
+
+    /**
+     * @brief Two-tier version of tryTwoOpt: 8-bit prescreen, exact verification
+     * @param distance Distance policy (the exact tier)
+     * @param state Current tour, updated if a move is applied
+     * @param stats Counters for this operator
+     * @return True if the tour was improved
+     *
+     * The removed edges and the reversed interior are known exactly from the prefix
+     * sums; only the two added edges are new lookups. Taking their quantized lower
+     * bounds gives a lower bound on the delta, computed for a block of j at a time
+     * in a SIMD loop over bytes. A candidate whose bound is not negative cannot
+     * improve and is skipped; the rest are verified on the exact matrix in scan
+     * order, so the move applied is the one tryTwoOpt would pick.
+     */
+    template <typename Distance>
+    bool tryTwoOptQuantized(const Distance& distance, TourState& state,
+                            OperatorStats& stats) const {
+        const std::vector<int>& t = state.tour;
+        const double* fwd = state.fwd.data();
+        const double* bwd = state.bwd.data();
+        int n = static_cast<int>(t.size());
+        alignas(64) double bound[kPrescreenBlock];
+
+        for (int i = 1; i < n - 1; ++i) {
+            int a = t[i - 1];
+            int b = t[i];
+            const uint8_t* qa = quantized_->row(a);
+            const uint8_t* qb = quantized_->row(b);
+            double minA = quantized_->rowMin(a), scaleA = quantized_->rowScale(a);
+            double minB = quantized_->rowMin(b), scaleB = quantized_->rowScale(b);
+            double fixed = minA + minB - (fwd[i] - fwd[i - 1]) + fwd[i] - bwd[i];
+
+            for (int j0 = i + 1; j0 < n; j0 += kPrescreenBlock) {
+                int count = std::min(kPrescreenBlock, n - j0);
+                #pragma omp simd
+                for (int k = 0; k < count; ++k) {
+                    int j = j0 + k;
+                    int c = t[j];
+                    int e = t[j + 1 < n ? j + 1 : 0];
+                    // Lower bound of d(a,c) + d(b,e) - d(a,b) - d(c,e) + bwd(i..j) - fwd(i..j)
+                    bound[k] = fixed + qa[c] * scaleA + qb[e] * scaleB
+                             - (fwd[j + 1] - fwd[j]) + bwd[j] - fwd[j];
+                }
+                stats.evaluations += count;
+
+                for (int k = 0; k < count; ++k) {
+                    if (bound[k] >= kImprovementEpsilon) continue;
+                    ++stats.verifications;
+                    int j = j0 + k;
+                    double delta = reversalDelta(distance, state, i, j);
+                    if (delta < -kImprovementEpsilon) {
+                        twoOptSwap(distance, state, i, j);
+                        stats.gain -= delta;
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Task-based version of tryTwoOpt for the Nested engine
+     * @param distance Distance policy
+     * @param state Current tour, updated if a move is applied
+     * @param stats Counters for this operator
+     * @return True if the tour was improved
+     *
+     * While fewer restarts remain than there are threads, the rows of the scan are
+     * cut into taskloop chunks that idle threads steal; the restart's own thread
+     * helps executing them while it waits. Once restarts outnumber threads the scan
+     * stays serial, since splitting would only add overhead. As in the worksharing
+     * version, the earliest improving row wins, so the move is the sequential one.
+     */
+    template <typename Distance>
+    bool tryTwoOptTasks(const Distance& distance, TourState& state, OperatorStats& stats) const {
+        int n = static_cast<int>(state.tour.size());
+        if (n < kTaskScanCities ||
+            unfinishedRestarts_.load(std::memory_order_relaxed) >= omp_get_num_threads()) {
+            return tryTwoOpt(distance, state, stats);
+        }
+
+        int firstRow = n;
+        int firstColumn = -1;
+        double firstDelta = 0.0;
+        long long evaluations = 0;
+        const TourState& view = state;
+
+        #pragma omp taskloop grainsize(kRowsPerTask) \
+            shared(firstRow, firstColumn, firstDelta, evaluations, view, distance)
+        for (int i = 1; i < n - 1; ++i) {
+            int limit;
+            #pragma omp atomic read
+            limit = firstRow;
+            if (i > limit) continue; // An earlier row already has an improving move
+
+            long long rowEvaluations = 0;
+            for (int j = i + 1; j < n; ++j) {
+                ++rowEvaluations;
+                double delta = reversalDelta(distance, view, i, j);
+                if (delta < -kImprovementEpsilon) {
+                    #pragma omp critical(two_opt_first_row)
+                    {
+                        if (i < firstRow) {
+                            firstRow = i;
+                            firstColumn = j;
+                            firstDelta = delta;
+                        }
+                    }
+                    break;
+                }
+            }
+            #pragma omp atomic
+            evaluations += rowEvaluations;
+        }
+
+        stats.evaluations += evaluations;
+        if (firstColumn < 0) return false;
+        twoOptSwap(distance, state, firstRow, firstColumn);
+        stats.gain -= firstDelta;
+        return true;
+    }
+
+    /**
+     * @brief Applies the first improving Or-opt move (segments of 1 to 3 cities)
+     * @param state Current tour, updated if a move is applied
+     * @param stats Counters for this operator
+     * @return True if the tour was improved
+     *
+     * The segment keeps its orientation, so its interior cost does not change and
+     * only the three edges around the cut and insertion points are compared.
+     * @param distance Distance policy
+     */
+    template <typename Distance>
+    static bool tryOrOpt(const Distance& distance, TourState& state, OperatorStats& stats) {
+        const std::vector<int>& tour = state.tour;
+        int n = static_cast<int>(tour.size());
+        for (int len = 1; len <= 3 && len <= n - 3; ++len) {
+            for (int i = 1; i + len - 1 < n; ++i) {
+                int first = tour[i];
+                int last = tour[i + len - 1];
+                int prev = tour[i - 1];
+                int next = tour[(i + len) % n];
+                double removeGain = distance(prev, first) + distance(last, next)
+                                  - distance(prev, next);
+
+                // Insert between tour[p] and tour[p + 1], outside the segment
+                for (int p = 0; p < n; ++p) {
+                    if (p >= i - 1 && p <= i + len - 1) continue;
+                    int u = tour[p];
+                    int v = tour[(p + 1) % n];
+                    ++stats.evaluations;
+                    double delta = distance(u, first) + distance(last, v)
+                                 - distance(u, v) - removeGain;
+                    if (delta < -kImprovementEpsilon) {
+                        std::vector<int>& t = state.tour;
+                        if (p > i) {
+                            std::rotate(t.begin() + i, t.begin() + i + len, t.begin() + p + 1);
+                        } else {
+                            std::rotate(t.begin() + p + 1, t.begin() + i, t.begin() + i + len);
+                        }
+                        refreshTourState(distance, state);
+                        stats.gain -= delta;
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Applies the first improving exchange of two cities
+     * @param distance Distance policy
+     * @param state Current tour, updated if a move is applied
+     * @param stats Counters for this operator
+     * @return True if the tour was improved
+     */
+    template <typename Distance>
+    static bool trySwap(const Distance& distance, TourState& state, OperatorStats& stats) {
+        const std::vector<int>& tour = state.tour;
+        int n = static_cast<int>(tour.size());
+        const Distance& d = distance;
+        for (int i = 1; i < n - 1; ++i) {
+            int pi = tour[i - 1], ci = tour[i], ni = tour[i + 1];
+            for (int j = i + 1; j < n; ++j) {
+                int pj = tour[j - 1], cj = tour[j], nj = tour[(j + 1) % n];
+                ++stats.evaluations;
+                double delta;
+                if (j == i + 1) {
+                    // Adjacent cities: pi -> ci -> cj -> nj becomes pi -> cj -> ci -> nj
+                    delta = d(pi, cj) + d(cj, ci) + d(ci, nj)
+                          - d(pi, ci) - d(ci, cj) - d(cj, nj);
+                } else {
+                    delta = d(pi, cj) + d(cj, ni) + d(pj, ci) + d(ci, nj)
+                          - d(pi, ci) - d(ci, ni) - d(pj, cj) - d(cj, nj);
+                }
+                if (delta < -kImprovementEpsilon) {
+                    std::swap(state.tour[i], state.tour[j]);
+                    refreshTourState(distance, state);
+                    stats.gain -= delta;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Applies the first improving Lin-Kernighan style chain of 2-opt moves
+     * @param distance Distance policy
+     * @param state Current tour, updated if a move is applied
+     * @param stats Counters for this operator
+     * @return True if the tour was improved
+     *
+     * Starting from edge (t1, t2) the chain repeatedly adds an edge (t2, t3) towards a
+     * near neighbour, removes (t4, t3) and closes the tour with (t1, t4). Each step is
+     * a 2-opt reversal; the chain continues while the open gain stays positive and the
+     * best prefix of the chain is kept. This reaches improvements that need several
+     * individually non-improving 2-opt moves.
+     */
+    template <typename Distance>
+    bool tryLinKernighan(const Distance& distance, TourState& state, OperatorStats& stats) const {
+        constexpr int kMaxDepth = 5;
+        const Distance& d = distance;
+        int n = static_cast<int>(state.tour.size());
+        if (n < 5) return false;
+
+        std::vector<std::pair<int, int>> applied; // (start, length) of each reversal
+        std::vector<int> used;                    // t3 cities already added in this chain
+        for (int start = 0; start < n; ++start) {
+            int t1 = state.tour[start];
+            double cumulative = 0.0;
+            double best = 0.0;
+            size_t bestDepth = 0;
+            applied.clear();
+            used.clear();
+
+            for (int depth = 0; depth < kMaxDepth; ++depth) {
+                int p1 = state.pos[t1];
+                int t2 = state.tour[(p1 + 1) % n];
+                double openGain = -cumulative + d(t1, t2);
+
+                // Pick the candidate whose closed tour is shortest
+                int bestT3 = -1;
+                double bestDelta = std::numeric_limits<double>::max();
+                for (int t3 : (*neighborLists_)[t2]) {
+                    if (t3 == t1 || t3 == state.tour[(state.pos[t2] + 1) % n]) continue;
+                    if (openGain - d(t2, t3) <= 0.0) continue;
+                    if (std::find(used.begin(), used.end(), t3) != used.end()) continue;
+                    int e = (state.pos[t3] - 1 + n) % n; // position of t4
+                    ++stats.evaluations;
+                    double delta = reversalDelta(distance, state, (p1 + 1) % n, e);
+                    if (delta < bestDelta) {
+                        bestDelta = delta;
+                        bestT3 = t3;
+                    }
+                }
+                if (bestT3 < 0) break;
+
+                int s = (p1 + 1) % n;
+                int length = (state.pos[bestT3] - 1 - s + 2 * n) % n + 1;
+                reverseCyclic(state.tour, s, length);
+                refreshTourState(distance, state);
+                applied.emplace_back(s, length);
+                used.push_back(bestT3);
+                cumulative += bestDelta;
+                if (cumulative < best - kImprovementEpsilon) {
+                    best = cumulative;
+                    bestDepth = applied.size();
+                }
+            }
+
+            // Undo the part of the chain after its best prefix
+            if (applied.size() > bestDepth) {
+                for (size_t k = applied.size(); k > bestDepth; --k) {
+                    reverseCyclic(state.tour, applied[k - 1].first, applied[k - 1].second);
+                }
+                refreshTourState(distance, state);
+            }
+            if (bestDepth > 0) {
+                normalizeTour(distance, state);
+                stats.gain -= best;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Applies the first improving segment insertion (or-3opt) move
+     * @param distance Distance policy
+     * @param state Current tour, updated if a move is applied
+     * @param stats Counters for this operator
+     * @return True if the tour was improved
+     *
+     * A segment tour[i..i+len-1] is cut out and reinserted between two adjacent
+     * cities u -> v, either as is (u -> first ... last -> v) or reversed
+     * (u -> last ... first -> v). Only insertion points where one of the new edges
+     * joins a segment end to one of its nearest neighbours are evaluated, so each
+     * segment costs O(k) instead of O(n). The reversed interior cost comes from the
+     * prefix sums, keeping every evaluation O(1) on asymmetric matrices as well.
+     */
+    template <typename Distance>
+    bool trySegmentInsertion(const Distance& distance, TourState& state,
+                             OperatorStats& stats) const {
+        const Distance& d = distance;
+        const std::vector<int>& tour = state.tour;
+        int n = static_cast<int>(tour.size());
+        int maxLength = std::min(options_.maxSegmentLength, n - 3);
+
+        for (int len = 1; len <= maxLength; ++len) {
+            for (int i = 1; i + len - 1 < n; ++i) {
+                int last = i + len - 1;
+                int first = tour[i];
+                int tail = tour[last];
+                int prev = tour[i - 1];
+                int next = tour[(last + 1) % n];
+                double removeGain = d(prev, first) + d(tail, next) - d(prev, next);
+                double reverseCost = (state.bwd[last] - state.bwd[i])
+                                   - (state.fwd[last] - state.fwd[i]);
+
+                // Evaluates inserting the segment after position p, in either orientation
+                auto tryInsert = [&](int p, bool reversed) {
+                    if (p >= i - 1 && p <= last) return false; // Edge touches the segment
+                    int u = tour[p];
+                    int v = tour[(p + 1) % n];
+                    ++stats.evaluations;
+                    double delta = reversed
+                        ? d(u, tail) + d(first, v) - d(u, v) + reverseCost - removeGain
+                        : d(u, first) + d(tail, v) - d(u, v) - removeGain;
+                    if (delta >= -kImprovementEpsilon) return false;
+
+                    std::vector<int>& t = state.tour;
+                    int newStart;
+                    if (p > i) {
+                        std::rotate(t.begin() + i, t.begin() + i + len, t.begin() + p + 1);
+                        newStart = p - len + 1;
+                    } else {
+                        std::rotate(t.begin() + p + 1, t.begin() + i, t.begin() + i + len);
+                        newStart = p + 1;
+                    }
+                    if (reversed) {
+                        std::reverse(t.begin() + newStart, t.begin() + newStart + len);
+                    }
+                    refreshTourState(distance, state);
+                    stats.gain -= delta;
+                    return true;
+                };
+
+                // New edge touching the segment's first city: (c, first) or (first, c)
+                for (int c : (*neighborLists_)[first]) {
+                    int pc = state.pos[c];
+                    if (tryInsert(pc, false)) return true;                  // c -> first ... last
+                    if (tryInsert((pc - 1 + n) % n, true)) return true;     // last ... first -> c
+                }
+                // New edge touching the segment's last city: (last, c) or (c, last)
+                for (int c : (*neighborLists_)[tail]) {
+                    int pc = state.pos[c];
+                    if (tryInsert((pc - 1 + n) % n, false)) return true;    // first ... last -> c
+                    if (tryInsert(pc, true)) return true;                   // c -> last ... first
+                }
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Dispatches one VND step to the selected operator
+     *
+     * The distance policy is picked once here, so every operator runs its
+     * instantiation for the matrix at hand.
+     */
+    bool applyOperator(MoveOperator op, TourState& state, OperatorStats& stats) const {
+        return withDistance([&](const auto& distance) {
+            switch (op) {
+                case MoveOperator::TwoOpt:
+                    switch (scanMode_) {
+                        case ScanMode::Parallel: return tryTwoOptParallel(distance, state, stats);
+                        case ScanMode::Tasks: return tryTwoOptTasks(distance, state, stats);
+                        default:
+                            if (quantized_) return tryTwoOptQuantized(distance, state, stats);
+                            return tryTwoOpt(distance, state, stats);
+                    }
+                case MoveOperator::OrOpt: return tryOrOpt(distance, state, stats);
+                case MoveOperator::Swap: return trySwap(distance, state, stats);
+                case MoveOperator::LinKernighan: return tryLinKernighan(distance, state, stats);
+                case MoveOperator::SegmentInsertion:
+                    return trySegmentInsertion(distance, state, stats);
+                case MoveOperator::TwoOptNeighbors:
+                    return tryTwoOptNeighbors(distance, state, stats);
+                case MoveOperator::BalasSimonetti:
+                    return tryBalasSimonetti(distance, state, stats, options_.windowWidth);
+            }
+            return false;
+        });
+    }
+
+    /**
+     * @brief Builds the shared data needed by the configured operators
+     */
+    void prepareOperators() {
+        bool diverse = options_.init == InitStrategy::Diverse;
+        if (usesNeighborLists(options_) && !neighborLists_) {
+            neighborLists_ = instance_->neighborLists(options_.neighborListSize);
+        }
+        if (diverse) {
+            edgeUsage_ = std::make_unique<EdgeUsageBitmap>(adjacencyMatrix_.size());
+        }
+        if (options_.quantize && !quantized_) {
+            quantized_ = instance_->quantized();
+        }
+    }
+
+    /**
+     * @brief Merges thread-local statistics into the solver totals (call inside a critical section)
+     * @param chain Thread-local chain order the statistics refer to
+     * @param stats Thread-local statistics, parallel to chain
+     */
+    void accumulateStats(const std::vector<MoveOperator>& chain,
+                         const std::vector<OperatorStats>& stats) {
+        for (size_t k = 0; k < chain.size(); ++k) {
+            auto it = std::find(options_.chain.begin(), options_.chain.end(), chain[k]);
+            operatorStats_[it - options_.chain.begin()] += stats[k];
+        }
+    }
+
+    /**
+     * @struct CoarseLevel
+     * @brief Result of one coarsening step
+     */
+    struct CoarseLevel {
+        DistanceMatrix matrix;                   ///< Distances between super-nodes
+        std::vector<std::vector<int>> members;   ///< Finer-level nodes of each super-node, in tour order
+    };
+
+    /**
+     * @brief Contracts close pairs of nodes of this instance into super-nodes
+     * @return Coarser instance with roughly half the nodes
+     *
+     * Every unmatched node is paired with its nearest unmatched neighbour and the pair
+     * becomes a fixed path a -> b (the cheaper direction). A super-node is entered at
+     * its first member and left from its last one, so the coarse distance X -> Y is
+     * d(last(X), first(Y)); the fixed interior edges are a constant that does not
+     * affect the search. Coarse matrices are asymmetric in general, which the move
+     * evaluation handles exactly.
+     */
+    CoarseLevel coarsen() {
+        if (!neighborLists_) {
+            neighborLists_ = instance_->neighborLists(options_.neighborListSize);
+        }
+        const auto& d = adjacencyMatrix_;
+        int n = static_cast<int>(d.size());
+
+        CoarseLevel level;
+        std::vector<bool> matched(n, false);
+        for (int x = 0; x < n; ++x) {
+            if (matched[x]) continue;
+            int mate = -1;
+            double mateCost = std::numeric_limits<double>::max();
+            for (int y : (*neighborLists_)[x]) {
+                double cost = std::min(d[x][y], d[y][x]);
+                if (!matched[y] && cost < mateCost) {
+                    mate = y;
+                    mateCost = cost;
+                }
+            }
+
+            matched[x] = true;
+            if (mate < 0) {
+                level.members.push_back({x});
+            } else {
+                matched[mate] = true;
+                level.members.push_back(d[x][mate] <= d[mate][x] ? std::vector<int>{x, mate}
+                                                                 : std::vector<int>{mate, x});
+            }
+        }
+
+        size_t m = level.members.size();
+        level.matrix = DistanceMatrix(m);
+        for (size_t X = 0; X < m; ++X) {
+            double* row = level.matrix.mutableRow(X);
+            for (size_t Y = 0; Y < m; ++Y) {
+                if (X != Y) row[Y] = d[level.members[X].back()][level.members[Y].front()];
+            }
+        }
+        return level;
+    }
+
+    /**
+     * @brief Multilevel solver: coarsen, solve the coarsest instance, then refine upwards
+     * @param numIterations Maximum improving moves per descent
+     * @param numRestarts Restarts used on the coarsest level
+     * @return Best tour found on the original instance
+     *
+     * The instance is repeatedly contracted (see coarsen) until it has at most
+     * coarsestSize nodes or matching stops making progress. The coarsest level is
+     * solved with the regular parallel shotgun search; its tour is then expanded one
+     * level at a time and polished with the VND chain, so the expensive full-size
+     * local search starts from an already good tour instead of a random one.
+     */
+    std::vector<int> solveMultilevel(int numIterations, int numRestarts) {
+        SearchOptions levelOptions = options_;
+        levelOptions.multilevel = false;
+
+        // Coarsening phase: levels[l] is the instance after l + 1 contractions
+        std::vector<std::unique_ptr<TSPSolver>> levels;
+        std::vector<std::vector<std::vector<int>>> members;
+        TSPSolver* current = this;
+        while (static_cast<int>(current->adjacencyMatrix_.size()) > options_.coarsestSize) {
+            CoarseLevel level = current->coarsen();
+            if (level.members.size() > 0.9 * current->adjacencyMatrix_.size()) break; // Stalled
+            members.push_back(std::move(level.members));
+            levels.push_back(std::make_unique<TSPSolver>(std::move(level.matrix), baseSeed_));
+            levels.back()->configureSearch(levelOptions);
+            current = levels.back().get();
+        }
+        if (levels.empty()) {
+            return shotgunHillClimbingParallel(numIterations, numRestarts);
+        }
+
+        // Solve the coarsest level
+        std::vector<int> tour = current->shotgunHillClimbingParallel(numIterations, numRestarts);
+        operatorStats_.assign(options_.chain.size(), OperatorStats{});
+        accumulateStats(options_.chain, current->operatorStats_);
+
+        // Uncoarsening phase: expand super-nodes and refine at every finer level
+        for (size_t l = levels.size(); l-- > 0; ) {
+            TSPSolver& finer = l == 0 ? *this : *levels[l - 1];
+            std::vector<int> expanded;
+            expanded.reserve(finer.adjacencyMatrix_.size());
+            for (int node : tour) {
+                expanded.insert(expanded.end(), members[l][node].begin(), members[l][node].end());
+            }
+
+            TourState state = finer.makeTourState(std::move(expanded));
+            finer.normalizeTour(state);
+            finer.prepareOperators();
+            std::vector<OperatorStats> stats(options_.chain.size());
+            finer.variableNeighborhoodDescent(state, numIterations, options_.chain, stats);
+            accumulateStats(options_.chain, stats);
+            tour = std::move(state.tour);
+        }
+        return tour;
+    }
+
+    /**
+     * @brief Restarts run one after another with the 2-opt scan parallelised inside each
+     * @param numIterations Maximum iterations per hill climb
+     * @param numRestarts Total number of random restarts
+     * @return Best tour found
+     *
+     * Preferred by the planner when there are fewer restarts than cores and each
+     * neighbourhood scan is long enough to amortise a fork/join per move.
+     */
+    std::vector<int> shotgunHillClimbingIntraRestart(int numIterations, int numRestarts) {
+        prepareOperators();
+        operatorStats_.assign(options_.chain.size(), OperatorStats{});
+        std::mt19937 gen(baseSeed_);
+        std::vector<MoveOperator> chain = options_.chain;
+        std::vector<OperatorStats> stats(chain.size());
+
+        std::vector<int> bestTour;
+        double bestLength = std::numeric_limits<double>::max();
+        scanMode_ = ScanMode::Parallel;
+        for (int restart = 0; restart < numRestarts; ++restart) {
+            auto [currentTour, currentLength] = hillClimb(numIterations, gen, chain, stats);
+            if (currentLength < bestLength) {
+                bestTour = std::move(currentTour);
+                bestLength = currentLength;
+            }
+        }
+        scanMode_ = ScanMode::Serial;
+        accumulateStats(chain, stats);
+        return bestTour;
+    }
+
+    /**
+     * @brief Two-level task parallelism: restarts outside, neighbourhood scans inside
+     * @param numIterations Maximum iterations per hill climb
+     * @param numRestarts Total number of random restarts
+     * @return Best tour found
+     *
+     * Every restart is an OpenMP task seeded with baseSeed + restart index, so the
+     * result does not depend on which thread runs it. With fewer restarts than
+     * threads (e.g. 20 restarts on 64 cores) the spare threads would sit idle under
+     * the shotgun engine; here they steal the 2-opt scan sub-tasks spawned by
+     * tryTwoOptTasks instead. With many restarts the scans stay serial and the
+     * engine behaves like plain parallel restarts.
+     */
+    std::vector<int> shotgunHillClimbingNested(int numIterations, int numRestarts) {
+        prepareOperators();
+        operatorStats_.assign(options_.chain.size(), OperatorStats{});
+        unfinishedRestarts_.store(numRestarts);
+        scanMode_ = ScanMode::Tasks;
+
+        std::vector<int> bestTour;
+        double bestLength = std::numeric_limits<double>::max();
+        int bestRestart = numRestarts;
+
+        #pragma omp parallel
+        #pragma omp single
+        {
+            for (int restart = 0; restart < numRestarts; ++restart) {
+                #pragma omp task firstprivate(restart) shared(bestTour, bestLength, bestRestart)
+                {
+                    std::mt19937 gen(baseSeed_ + restart);
+                    std::vector<MoveOperator> chain = options_.chain;
+                    std::vector<OperatorStats> stats(chain.size());
+                    auto [tour, length] = hillClimb(numIterations, gen, chain, stats);
+                    unfinishedRestarts_.fetch_sub(1, std::memory_order_relaxed);
+
+                    // Ties go to the lowest restart index to keep the result deterministic
+                    #pragma omp critical
+                    {
+                        accumulateStats(chain, stats);
+                        if (length < bestLength || (length == bestLength && restart < bestRestart)) {
+                            bestTour = std::move(tour);
+                            bestLength = length;
+                            bestRestart = restart;
+                        }
+                    }
+                }
+            }
+        } // Implicit barrier: all restart tasks and their sub-tasks are done
+
+        scanMode_ = ScanMode::Serial;
+        return bestTour;
+    }
+
+    /**
+     * @struct InterleavedDescent
+     * @brief A 2-opt descent that can be suspended between batches of evaluations
+     *
+     * Hand-rolled coroutine: the cursor (i, j) of the first-improvement scan is the
+     * whole resumable state, so switching descents costs nothing.
+     */
+    struct InterleavedDescent {
+        TourState state;
+        int i = 1;           ///< Row of the next candidate move
+        int j = 2;           ///< Column of the next candidate move
+        int iterations = 0;  ///< Improving moves applied so far
+        bool done = false;   ///< Local optimum or iteration budget reached
+    };
+
+    /// Candidate moves evaluated per turn of an interleaved descent
+    static constexpr int kInterleaveBatch = 32;
+
+    /**
+     * @brief Prefetches the matrix entries the next batch of a descent will read
+     * @param distance Distance policy
+     * @param descent Suspended descent
+     *
+     * The two rows of a scan row i are fixed, but the columns follow the tour, so
+     * every lookup lands on a different cache line of a large matrix. Policies
+     * that compute or unfold their entries have no stored entry to prefetch.
+     */
+    template <typename Distance>
+    void prefetchBatch(const Distance& distance, const InterleavedDescent& descent) const {
+        constexpr bool strided = std::is_same_v<Distance, DenseDistance> ||
+                                 std::is_same_v<Distance, TypedDistance<float>> ||
+                                 std::is_same_v<Distance, TypedDistance<int32_t>>;
+        if constexpr (strided || std::is_same_v<Distance, CachedDistance>) {
+            auto entry = [&distance](int a, int b) {
+                if constexpr (strided) {
+                    return distance.data + static_cast<size_t>(a) * distance.stride + b;
+                } else {
+                    return (*distance.matrix)[a] + b;
+                }
+            };
+            prefetchEntries(descent, entry);
+        }
+    }
+
+    /**
+     * @brief Prefetch loop of prefetchBatch over the entry addresses given by entry(a, b)
+     */
+    template <typename Entry>
+    static void prefetchEntries(const InterleavedDescent& descent, const Entry& entry) {
+        const std::vector<int>& t = descent.state.tour;
+        int n = static_cast<int>(t.size());
+        int i = descent.i;
+        int j = descent.j;
+        for (int k = 0; k < kInterleaveBatch && i < n - 1; ++k) {
+            __builtin_prefetch(entry(t[i - 1], t[j]));
+            __builtin_prefetch(entry(t[i], t[(j + 1) % n]));
+            if (++j == n) {
+                ++i;
+                j = i + 1;
+            }
+        }
+    }
+
+    /**
+     * @brief Resumes a descent for one batch of 2-opt evaluations
+     * @param distance Distance policy
+     * @param descent Descent to advance
+     * @param numIterations Improving move budget
+     * @param stats 2-opt counters
+     *
+     * Same scan order and acceptance rule as tryTwoOpt, so every descent follows
+     * exactly the trajectory it would have when run alone.
+     */
+    template <typename Distance>
+    static void stepDescent(const Distance& distance, InterleavedDescent& descent,
+                            int numIterations, OperatorStats& stats) {
+        int n = static_cast<int>(descent.state.tour.size());
+        int i = descent.i;
+        int j = descent.j;
+        for (int k = 0; k < kInterleaveBatch; ++k) {
+            if (i >= n - 1) {
+                descent.done = true; // Full scan without improvement: local optimum
+                return;
+            }
+            ++stats.evaluations;
+            double delta = reversalDelta(distance, descent.state, i, j);
+            if (delta < -kImprovementEpsilon) {
+                twoOptSwap(distance, descent.state, i, j);
+                stats.gain -= delta;
+                ++stats.improvements;
+                ++stats.calls;
+                descent.i = 1;
+                descent.j = 2;
+                descent.done = ++descent.iterations >= numIterations;
+                return;
+            }
+            if (++j == n) {
+                ++i;
+                j = i + 1;
+            }
+        }
+        descent.i = i;
+        descent.j = j;
+    }
+
+    /**
+     * @brief Runs a group of restarts interleaved on the calling thread
+     * @param groupSize Number of restarts in the group
+     * @param numIterations Maximum improving moves per restart
+     * @param gen Random number generator for this thread
+     * @param chain Operator chain; must start with 2-opt
+     * @param stats Per-operator counters, parallel to chain
+     * @return (tour, length) of every restart in the group
+     *
+     * Round-robin over the descents: each turn evaluates the batch whose matrix
+     * entries were prefetched on its previous turn, then prefetches the next batch
+     * and yields. The other descents' batches give the prefetches time to land, so
+     * one thread keeps several cache misses in flight instead of stalling on each.
+     * The remaining operators of the chain run afterwards with the regular VND.
+     */
+    std::vector<std::pair<std::vector<int>, double>>
+    interleavedHillClimb(int groupSize, int numIterations, std::mt19937& gen,
+                         const std::vector<MoveOperator>& chain,
+                         std::vector<OperatorStats>& stats) {
+        std::vector<InterleavedDescent> group(groupSize);
+        for (InterleavedDescent& descent : group) {
+            descent.state = makeTourState(generateInitialTour(gen));
+            descent.done = descent.state.tour.size() < 3;
+        }
+
+        withDistance([&](const auto& distance) {
+            int active = groupSize;
+            for (long round = 1; active > 0; ++round) {
+                if (stopping() ||
+                    (round % kCancelPollRounds == 0 && (preemptionPoint(), pollCancel()))) {
+                    break;
+                }
+                for (InterleavedDescent& descent : group) {
+                    if (descent.done) continue;
+                    stepDescent(distance, descent, numIterations, stats[0]);
+                    if (descent.done) {
+                        ++stats[0].calls; // The final, unsuccessful scan
+                        --active;
+                    } else {
+                        prefetchBatch(distance, descent);
+                    }
+                }
+            }
+        });
+
+        std::vector<std::pair<std::vector<int>, double>> results;
+        for (InterleavedDescent& descent : group) {
+            if (chain.size() > 1 && descent.iterations < numIterations) {
+                variableNeighborhoodDescent(descent.state, numIterations - descent.iterations,
+                                            chain, stats);
+            }
+            if (edgeUsage_) {
+                edgeUsage_->mark(descent.state.tour);
+            }
+            restartFinished(descent.state.length);
+            results.emplace_back(std::move(descent.state.tour), descent.state.length);
+        }
+        return results;
+    }
+
+    /**
+     * @struct LaneBatch
+     * @brief kLanes tours stored lane-interleaved: entry k of lane l lives at [k * kLanes + l]
+     *
+     * With this layout the values every lane needs for the same move (i, j) sit in one
+     * contiguous block, so the evaluation loop over lanes is a plain SIMD loop and
+     * only the matrix lookups are gathers.
+     */
+    struct LaneBatch {
+        std::vector<int> tour;    ///< Tours, lane-interleaved
+        std::vector<double> fwd;  ///< Prefix lengths in tour direction, lane-interleaved
+        std::vector<double> bwd;  ///< Prefix lengths against tour direction, lane-interleaved
+    };
+
+    /**
+     * @brief Recomputes the prefix lengths of one lane after its tour changed
+     * @param distance Distance policy of a stored matrix (see withStoredDistance)
+     */
+    template <typename Distance>
+    static void refreshLane(const Distance& distance, LaneBatch& batch, int lane) {
+        int n = static_cast<int>(batch.tour.size() / kLanes);
+        batch.fwd[lane] = 0.0;
+        batch.bwd[lane] = 0.0;
+        for (int k = 0; k < n; ++k) {
+            int a = batch.tour[k * kLanes + lane];
+            int b = batch.tour[((k + 1) % n) * kLanes + lane];
+            batch.fwd[(k + 1) * kLanes + lane] = batch.fwd[k * kLanes + lane] + distance(a, b);
+            batch.bwd[(k + 1) * kLanes + lane] = batch.bwd[k * kLanes + lane] + distance(b, a);
+        }
+    }
+
+    /**
+     * @brief Runs up to kLanes 2-opt descents in lockstep, one per SIMD lane
+     * @param distance Distance policy of a stored matrix (see withStoredDistance)
+     * @param groupSize Restarts in this batch (at most kLanes; spare lanes stay masked)
+     * @param numIterations Maximum improving moves per restart
+     * @param gen Random number generator for this thread
+     * @param chain Operator chain; must start with 2-opt
+     * @param stats Per-operator counters, parallel to chain
+     * @return (tour, length) of every restart in the batch
+     *
+     * All lanes walk the same (i, j) sequence and evaluate that move on their own
+     * tour at once. A lane whose delta improves applies the move (masked acceptance)
+     * and keeps scanning from the next candidate, so a lane is a first-improvement
+     * descent that does not rewind its scan after a move. A lane retires after a full
+     * sweep without improvement or when its move budget is spent. The remaining
+     * operators of the chain run afterwards with the regular VND.
+     */
+    template <typename Distance>
+    std::vector<std::pair<std::vector<int>, double>>
+    laneHillClimb(const Distance& distance, int groupSize, int numIterations, std::mt19937& gen,
+                  const std::vector<MoveOperator>& chain, std::vector<OperatorStats>& stats) {
+        const int n = static_cast<int>(adjacencyMatrix_.size());
+        LaneBatch batch;
+        batch.tour.resize(static_cast<size_t>(n) * kLanes);
+        batch.fwd.resize(static_cast<size_t>(n + 1) * kLanes);
+        batch.bwd.resize(static_cast<size_t>(n + 1) * kLanes);
+
+        // Spare lanes replay lane 0 with the mask off so the SIMD loop stays full width
+        alignas(64) int active[kLanes];
+        for (int l = 0; l < kLanes; ++l) {
+            std::vector<int> start = l < groupSize ? generateInitialTour(gen)
+                                                   : std::vector<int>(n, 0);
+            if (l >= groupSize) {
+                for (int k = 0; k < n; ++k) start[k] = batch.tour[k * kLanes];
+            }
+            for (int k = 0; k < n; ++k) batch.tour[k * kLanes + l] = start[k];
+            refreshLane(distance, batch, l);
+            active[l] = l < groupSize && n >= 3;
+        }
+
+        std::vector<int> iterations(kLanes, 0);
+        OperatorStats& twoOpt = stats[0];
+        bool anyActive = std::any_of(active, active + kLanes, [](int a) { return a != 0; });
+        while (anyActive && (preemptionPoint(), !pollCancel())) {
+            int improved[kLanes] = {};
+            int lanesInSweep = static_cast<int>(std::count(active, active + kLanes, 1));
+            twoOpt.calls += lanesInSweep;
+
+            for (int i = 1; i < n - 1; ++i) {
+                for (int j = i + 1; j < n; ++j) {
+                    const int* ta = &batch.tour[(i - 1) * kLanes];
+                    const int* tb = &batch.tour[i * kLanes];
+                    const int* tc = &batch.tour[j * kLanes];
+                    const int* te = &batch.tour[((j + 1) % n) * kLanes];
+                    const double* fi = &batch.fwd[i * kLanes];
+                    const double* fj = &batch.fwd[j * kLanes];
+                    const double* bi = &batch.bwd[i * kLanes];
+                    const double* bj = &batch.bwd[j * kLanes];
+                    alignas(64) double delta[kLanes];
+                    int hit = 0;
+
+                    #pragma omp simd reduction(|:hit)
+                    for (int l = 0; l < kLanes; ++l) {
+                        int a = ta[l], b = tb[l], c = tc[l], e = te[l];
+                        delta[l] = distance(a, c) + distance(b, e)
+                                 - distance(a, b) - distance(c, e)
+                                 + (bj[l] - bi[l]) - (fj[l] - fi[l]);
+                        hit |= active[l] & (delta[l] < -kImprovementEpsilon);
+                    }
+                    twoOpt.evaluations += lanesInSweep;
+                    if (!hit) continue;
+
+                    // Rare path: apply the move in every lane that found one
+                    for (int l = 0; l < kLanes; ++l) {
+                        if (!active[l] || delta[l] >= -kImprovementEpsilon) continue;
+                        for (int lo = i, hi = j; lo < hi; ++lo, --hi) {
+                            std::swap(batch.tour[lo * kLanes + l], batch.tour[hi * kLanes + l]);
+                        }
+                        refreshLane(distance, batch, l);
+                        twoOpt.gain -= delta[l];
+                        ++twoOpt.improvements;
+                        improved[l] = 1;
+                        if (++iterations[l] >= numIterations) active[l] = 0;
+                    }
+                }
+            }
+
+            anyActive = false;
+            for (int l = 0; l < kLanes; ++l) {
+                if (!improved[l]) active[l] = 0; // Full sweep without improvement: local optimum
+                anyActive = anyActive || active[l];
+            }
+        }
+
+        std::vector<std::pair<std::vector<int>, double>> results;
+        for (int l = 0; l < groupSize; ++l) {
+            std::vector<int> tour(n);
+            for (int k = 0; k < n; ++k) tour[k] = batch.tour[k * kLanes + l];
+            TourState state = makeTourState(std::move(tour));
+            if (chain.size() > 1 && iterations[l] < numIterations) {
+                variableNeighborhoodDescent(state, numIterations - iterations[l], chain, stats);
+            }
+            if (edgeUsage_) {
+                edgeUsage_->mark(state.tour);
+            }
+            restartFinished(state.length);
+            results.emplace_back(std::move(state.tour), state.length);
+        }
+        return results;
+    }
+
+    /**
+     * @brief Parallel restarts where every thread runs batches of kLanes lockstep descents
+     * @param numIterations Maximum iterations per hill climb
+     * @param numRestarts Total number of random restarts
+     * @return Best tour found across all threads
+     *
+     * Meant for small instances whose matrix fits in L2, where a descent is bound by
+     * arithmetic rather than memory and the lanes multiply restart throughput per
+     * core. Threads get the same restarts and start tours as the shotgun engine.
+     * Build with -march=native so the lane loop can use hardware gathers.
+     */
+    std::vector<int> shotgunHillClimbingLanes(int numIterations, int numRestarts) {
+        std::vector<int> bestTour;
+        double bestLength = std::numeric_limits<double>::max();
+        prepareOperators();
+        operatorStats_.assign(options_.chain.size(), OperatorStats{});
+        #pragma omp parallel
+        {
+            std::mt19937 localGen(baseSeed_ + omp_get_thread_num());
+            std::vector<int> localBestTour;
+            double localBestLength = std::numeric_limits<double>::max();
+            std::vector<MoveOperator> localChain = options_.chain;
+            std::vector<OperatorStats> localStats(localChain.size());
+
+            std::vector<int> myRestarts;
+            #pragma omp for schedule(static)
+            for (int restart = 0; restart < numRestarts; ++restart) {
+                myRestarts.push_back(restart);
+            }
+
+            for (size_t first = 0; first < myRestarts.size(); first += kLanes) {
+                int size = static_cast<int>(std::min<size_t>(kLanes, myRestarts.size() - first));
+                std::vector<std::pair<std::vector<int>, double>> results;
+                if (localChain.front() == MoveOperator::TwoOpt) {
+                    results = withStoredDistance([&](const auto& distance) {
+                        return laneHillClimb(distance, size, numIterations, localGen,
+                                             localChain, localStats);
+                    });
+                    if (options_.adaptiveOrder) rankChain(localChain, localStats);
+                } else {
+                    for (int k = 0; k < size; ++k) {
+                        results.push_back(hillClimb(numIterations, localGen, localChain, localStats));
+                    }
+                }
+
+                for (auto& [tour, length] : results) {
+                    if (length < localBestLength) {
+                        localBestTour = std::move(tour);
+                        localBestLength = length;
+                    }
+                }
+            }
+
+            #pragma omp critical
+            {
+                accumulateStats(localChain, localStats);
+                if (localBestLength < bestLength) {
+                    bestTour = std::move(localBestTour);
+                    bestLength = localBestLength;
+                }
+            }
+        }
+
+        return bestTour;
+    }
+
+    /**
+     * @brief Parallel restarts where every thread interleaves several descents
+     * @param numIterations Maximum iterations per hill climb
+     * @param numRestarts Total number of random restarts
+     * @return Best tour found across all threads
+     *
+     * Threads get the same restarts and seeds as shotgunHillClimbingParallel and
+     * process them in groups of options.interleave (see interleavedHillClimb). This
+     * is memory-level parallelism for the latency-bound scan of matrices that do not
+     * fit in cache, without extra threads. Chains that do not start with 2-opt fall
+     * back to one restart at a time.
+     */
+    std::vector<int> shotgunHillClimbingInterleaved(int numIterations, int numRestarts) {
+        std::vector<int> bestTour;
+        double bestLength = std::numeric_limits<double>::max();
+        prepareOperators();
+        operatorStats_.assign(options_.chain.size(), OperatorStats{});
+        int groupSize = std::max(1, options_.interleave);
+
+        #pragma omp parallel
+        {
+            std::mt19937 localGen(baseSeed_ + omp_get_thread_num());
+            std::vector<int> localBestTour;
+            double localBestLength = std::numeric_limits<double>::max();
+            std::vector<MoveOperator> localChain = options_.chain;
+            std::vector<OperatorStats> localStats(localChain.size());
+
+            // Collect this thread's share of the restarts, then run them in groups
+            std::vector<int> myRestarts;
+            #pragma omp for schedule(static)
+            for (int restart = 0; restart < numRestarts; ++restart) {
+                myRestarts.push_back(restart);
+            }
+
+            for (size_t first = 0; first < myRestarts.size(); first += groupSize) {
+                int size = static_cast<int>(std::min<size_t>(groupSize, myRestarts.size() - first));
+                std::vector<std::pair<std::vector<int>, double>> results;
+                if (localChain.front() == MoveOperator::TwoOpt) {
+                    results = interleavedHillClimb(size, numIterations, localGen,
+                                                   localChain, localStats);
+                    if (options_.adaptiveOrder) rankChain(localChain, localStats);
+                } else {
+                    for (int k = 0; k < size; ++k) {
+                        results.push_back(hillClimb(numIterations, localGen, localChain, localStats));
+                    }
+                }
+
+                for (auto& [tour, length] : results) {
+                    if (length < localBestLength) {
+                        localBestTour = std::move(tour);
+                        localBestLength = length;
+                    }
+                }
+            }
+
+            #pragma omp critical
+            {
+                accumulateStats(localChain, localStats);
+                if (localBestLength < bestLength) {
+                    bestTour = std::move(localBestTour);
+                    bestLength = localBestLength;
+                }
+            }
+        }
+
+        return bestTour;
+    }
+
+    /**
+     * @brief Parallel implementation of shotgun hill climbing using OpenMP
+     * @param numIterations Maximum iterations per hill climb
+     * @param numRestarts Total number of random restarts
+     * @return Best tour found across all threads
+     * 
+     * This method distributes the restarts across multiple threads, where each
+     * thread runs independent hill climbing instances with different random seeds.
+     * The best solution found by any thread is returned.
+     *
+     * With a release hook (a scheduled job) restarts are instead taken one at a
+     * time and seeded by their index: a parked thread's remaining restarts go to
+     * its teammates, and a thread that finds none left gives its core back at
+     * once rather than holding it at the closing barrier.
+     */
+    std::vector<int> shotgunHillClimbingParallel(int numIterations, int numRestarts) {
+        std::vector<int> bestTour;
+        double bestLength = std::numeric_limits<double>::max();
+
+        // Shared read-only data must exist before threads start using it
+        prepareOperators();
+        operatorStats_.assign(options_.chain.size(), OperatorStats{});
+        bool releasing = static_cast<bool>(options_.release);
+        std::atomic<int> nextRestart{0};
+
+        // Parallel region - each thread executes this block
+        #pragma omp parallel
+        {
+            // Each thread gets unique random generator with different seed
+            int threadId = omp_get_thread_num();
+            std::mt19937 localGen(baseSeed_ + threadId);
+            
+            // Thread-local variables to avoid race conditions
+            std::vector<int> localBestTour;
+            double localBestLength = std::numeric_limits<double>::max();
+            std::vector<MoveOperator> localChain = options_.chain;
+            std::vector<OperatorStats> localStats(localChain.size());
+
+            auto runRestart = [&]() {
+                // Run hill climbing from random starting point
+                auto [currentTour, currentLength] = hillClimb(numIterations, localGen,
+                                                              localChain, localStats);
+
+                // Update thread-local best if improvement found
+                if (currentLength < localBestLength) {
+                    localBestTour = currentTour;
+                    localBestLength = currentLength;
+                }
+            };
+            if (releasing) {
+                for (int restart; (restart = nextRestart.fetch_add(1)) < numRestarts; ) {
+                    localGen.seed(baseSeed_ + restart);
+                    runRestart();
+                }
+            } else {
+                // Distribute restarts among threads using OpenMP work-sharing
+                #pragma omp for
+                for (int restart = 0; restart < numRestarts; ++restart) {
+                    runRestart();
+                }
+            }
+
+            // Critical section to safely compare results from all threads
+            #pragma omp critical
+            {
+                accumulateStats(localChain, localStats);
+                if (localBestLength < bestLength) {
+                    bestTour = std::move(localBestTour); // Move semantics for efficiency
+                    bestLength = localBestLength;
+                }
+            }
+            if (releasing) releaseCore(); // Out of restarts: only the closing barrier is left
+        } // End of parallel region
+        preemptionPoint(); // Take a core back for the work after the region
+
+        return bestTour;
+    }
+
+    /**
+     * @brief Large neighbourhood search: parallel destroy/repair attempts on one tour
+     * @param numIterations Maximum improving moves of the first descent and of each polish
+     * @param numRestarts Number of rounds
+     * @return Best tour found
+     *
+     * A single tour is built and descended as a restart would be, then improved
+     * round by round. In every round each thread copies the tour, removes
+     * lnsRemove cities, either at random or a cluster grown over the neighbour
+     * lists from a random city, and reinserts them (see lnsAttempt). The best
+     * attempt of the round replaces the tour if it is shorter; ties go to the
+     * lowest thread, so a fixed seed and thread count reproduce the result.
+     */
+    std::vector<int> largeNeighborhoodSearch(int numIterations, int numRestarts) {
+        prepareOperators();
+        operatorStats_.assign(options_.chain.size(), OperatorStats{});
+
+        std::vector<MoveOperator> chain = options_.chain;
+        std::vector<OperatorStats> stats(chain.size());
+        std::mt19937 gen(baseSeed_);
+        TourState current = makeTourState(generateInitialTour(gen));
+        preemptionPoint();
+        bool stop = pollCancel();
+        if (!stop) variableNeighborhoodDescent(current, numIterations, chain, stats);
+        accumulateStats(chain, stats);
+
+        int n = static_cast<int>(current.tour.size());
+        if (n < 5) {
+            restartFinished(current.length); // Too small to leave anything to repair
+            return current.tour;
+        }
+        int remove = options_.lnsRemove > 0 ? options_.lnsRemove
+                                            : std::clamp(n / 20, 5, kLnsMaxRemoved);
+        remove = std::min(remove, n - 2);
+
+        std::vector<std::vector<int>> attempts(omp_get_max_threads());
+        std::vector<double> attemptLengths(attempts.size());
+
+        #pragma omp parallel
+        {
+            int threadId = omp_get_thread_num();
+            std::mt19937 localGen(baseSeed_ + 1 + threadId);
+            std::vector<MoveOperator> localChain = options_.chain;
+            std::vector<OperatorStats> localStats(localChain.size());
+            LnsWorkspace workspace(n);
+
+            for (int round = 0; round < numRestarts && !stop; ++round) {
+                preemptionPoint();
+                std::vector<int>& attempt = attempts[threadId];
+                attemptLengths[threadId] = withDistance([&](const auto& distance) {
+                    return lnsAttempt(distance, current, remove, localGen, workspace, attempt);
+                });
+                if (options_.lnsPolish && !stopping()) {
+                    TourState polished = makeTourState(std::move(attempt));
+                    variableNeighborhoodDescent(polished, numIterations, localChain, localStats);
+                    attempt = std::move(polished.tour);
+                    attemptLengths[threadId] = polished.length;
+                }
+
+                // Every attempt must be in before one thread commits the best of them
+                #pragma omp barrier
+                #pragma omp single
+                {
+                    int best = 0;
+                    for (int t = 1; t < omp_get_num_threads(); ++t) {
+                        if (attemptLengths[t] < attemptLengths[best]) best = t;
+                    }
+                    if (attemptLengths[best] < current.length - kImprovementEpsilon) {
+                        current.tour.swap(attempts[best]);
+                        refreshTourState(current); // Exact length, free of summed insertion deltas
+                    }
+                    restartFinished(current.length);
+                    stop = pollCancel();
+                } // Implicit barrier: every thread sees the new tour and the same stop flag
+            }
+
+            #pragma omp critical
+            accumulateStats(localChain, localStats);
+        }
+
+        return current.tour;
+    }
+
+    /// Upper bound on the default number of cities removed per LNS attempt
+    static constexpr int kLnsMaxRemoved = 60;
+
+    /**
+     * @struct LnsWorkspace
+     * @brief Per-thread scratch of lnsAttempt, allocated once per solve
+     *
+     * The tour copy is a doubly linked list so that removing and inserting a city
+     * costs O(1) instead of shifting the array.
+     */
+    struct LnsWorkspace {
+        std::vector<int> next;       ///< Successor of each city in the partial tour
+        std::vector<int> prev;       ///< Predecessor of each city in the partial tour
+        std::vector<char> removed;   ///< 1 while a city waits for reinsertion
+        std::vector<int> pending;    ///< Cities still to reinsert
+        std::vector<int> frontier;   ///< Spatial destroy: breadth-first queue
+
+        explicit LnsWorkspace(int n) : next(n), prev(n), removed(n, 0) {}
+    };
+
+    /**
+     * @brief One destroy/repair attempt on a private copy of the current tour
+     * @param distance Distance policy (see withDistance)
+     * @param current Tour to start from; only read
+     * @param remove Number of cities to remove (city 0 always stays)
+     * @param gen Thread-local random generator
+     * @param workspace Thread-local scratch
+     * @param result Repaired tour, starting at city 0
+     * @return Length of result
+     *
+     * Destroy removes either random cities or a cluster grown breadth-first over
+     * the neighbour lists from a random city (topped up at random if the cluster
+     * runs dry). Repair inserts one pending city per step: by regret-2, the city
+     * whose best and second best insertion differ most goes first, so the cities
+     * with the fewest good options are placed before others take them; otherwise
+     * the cheapest insertion overall. Only the edges next to a city's candidate
+     * neighbours are tried, the whole partial tour only if none of them is in it,
+     * which keeps an attempt at O(R^2 k) after the O(n) copy.
+     */
+    template <typename Distance>
+    double lnsAttempt(const Distance& distance, const TourState& current, int remove,
+                      std::mt19937& gen, LnsWorkspace& workspace, std::vector<int>& result) const {
+        const std::vector<int>& tour = current.tour;
+        const NeighborLists& lists = *neighborLists_;
+        int n = static_cast<int>(tour.size());
+        std::vector<int>& next = workspace.next;
+        std::vector<int>& prev = workspace.prev;
+        std::vector<char>& removed = workspace.removed;
+        std::vector<int>& pending = workspace.pending;
+        for (int k = 0; k < n; ++k) {
+            int a = tour[k];
+            int b = tour[k + 1 < n ? k + 1 : 0];
+            next[a] = b;
+            prev[b] = a;
+        }
+
+        // Destroy
+        std::uniform_int_distribution<int> randomCity(1, n - 1);
+        pending.clear();
+        auto take = [&](int city) {
+            if (city == 0 || removed[city]) return;
+            removed[city] = 1;
+            pending.push_back(city);
+        };
+        if (gen() & 1) {
+            std::vector<int>& frontier = workspace.frontier;
+            frontier.clear();
+            int seed = randomCity(gen);
+            take(seed);
+            frontier.push_back(seed);
+            for (size_t head = 0; head < frontier.size() &&
+                                  static_cast<int>(pending.size()) < remove; ++head) {
+                for (int c : lists[frontier[head]]) {
+                    if (static_cast<int>(pending.size()) == remove) break;
+                    if (c == 0 || removed[c]) continue;
+                    take(c);
+                    frontier.push_back(c);
+                }
+            }
+        }
+        while (static_cast<int>(pending.size()) < remove) {
+            take(randomCity(gen));
+        }
+
+        double length = current.length;
+        for (int c : pending) {
+            int a = prev[c];
+            int b = next[c];
+            length += distance(a, b) - distance(a, c) - distance(c, b);
+            next[a] = b;
+            prev[b] = a;
+        }
+
+        // Repair
+        const double infinity = std::numeric_limits<double>::infinity();
+        while (!pending.empty()) {
+            size_t chosen = 0;
+            int chosenAfter = 0;
+            double chosenCost = infinity;
+            double chosenScore = -infinity;
+            for (size_t p = 0; p < pending.size(); ++p) {
+                int c = pending[p];
+                double best = infinity;
+                double second = infinity;
+                int bestAfter = -1;
+                auto consider = [&](int a) {
+                    if (a == bestAfter) return; // Same edge reached from both of its ends
+                    int b = next[a];
+                    double cost = distance(a, c) + distance(c, b) - distance(a, b);
+                    if (cost < best) {
+                        second = best;
+                        best = cost;
+                        bestAfter = a;
+                    } else if (cost < second) {
+                        second = cost;
+                    }
+                };
+                for (int v : lists[c]) {
+                    if (removed[v]) continue;
+                    consider(prev[v]);
+                    consider(v);
+                }
+                if (bestAfter < 0) {
+                    int a = 0;
+                    do {
+                        consider(a);
+                        a = next[a];
+                    } while (a != 0);
+                }
+                double score = options_.regretRepair ? second - best : -best;
+                if (score > chosenScore) {
+                    chosen = p;
+                    chosenAfter = bestAfter;
+                    chosenCost = best;
+                    chosenScore = score;
+                }
+            }
+
+            int c = pending[chosen];
+            int b = next[chosenAfter];
+            next[chosenAfter] = c;
+            prev[c] = chosenAfter;
+            next[c] = b;
+            prev[b] = c;
+            removed[c] = 0;
+            length += chosenCost;
+            pending[chosen] = pending.back();
+            pending.pop_back();
+        }
+
+        result.resize(n);
+        int city = 0;
+        for (int k = 0; k < n; ++k) {
+            result[k] = city;
+            city = next[city];
+        }
+        return length;
+    }
+
+    /**
+     * @brief LNS attempt through a row cache: insertion costs read single entries (at)
+     *        instead of fetching a row per candidate
+     */
+    double lnsAttempt(const CachedDistance& distance, const TourState& current, int remove,
+                      std::mt19937& gen, LnsWorkspace& workspace, std::vector<int>& result) const {
+        const DistanceMatrix& matrix = *distance.matrix;
+        return lnsAttempt(FunctionDistance{[&matrix](int a, int b) { return matrix.at(a, b); }},
+                          current, remove, gen, workspace, result);
+    }
+
+    /**
+     * @brief Single hill climbing run driven by a Variable Neighborhood Descent chain
+     * @param numIterations Maximum number of improving moves before giving up
+     * @param gen Random number generator for this instance
+     * @param chain Operators in the order they are tried (cheapest first)
+     * @param stats Per-operator counters, parallel to chain
+     * @return Pair of (best tour found, tour length)
+     *
+     * VND tries the first operator of the chain until it stalls, then falls through
+     * to the next one; whenever an operator improves the tour the descent restarts
+     * from the cheapest operator. Stops when every operator is at a local optimum
+     * or max iterations reached. With adaptive ordering the chain is re-ranked
+     * after the run by evaluations spent per unit of gain.
+     */
+    std::pair<std::vector<int>, double> hillClimb(int numIterations, std::mt19937& gen,
+                                                  std::vector<MoveOperator>& chain,
+                                                  std::vector<OperatorStats>& stats) {
+        TourState state = makeTourState(generateInitialTour(gen)); // Random or diverse start
+        preemptionPoint();
+        if (!pollCancel()) {
+            variableNeighborhoodDescent(state, numIterations, chain, stats);
+        }
+        if (edgeUsage_) {
+            edgeUsage_->mark(state.tour); // Later restarts steer away from this basin
+        }
+        restartFinished(state.length);
+
+        if (options_.adaptiveOrder) {
+            rankChain(chain, stats);
+        }
+        return {state.tour, state.length};
+    }
+
+    /**
+     * @brief Cheap stop check (one or two relaxed loads), run before every move
+     * @return True once the callback said stop or the cancel token was raised
+     */
+    bool stopping() const {
+        if (stopRequested_.load(std::memory_order_relaxed)) return true;
+        if (!options_.cancelToken.cancelled()) return false;
+        stopRequested_.store(true, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief Asks the cancel callback whether to stop, remembering a yes
+     * @return True once the solve should wind down
+     *
+     * Callbacks run under one named critical section, so user code never sees
+     * two concurrent calls even though any worker thread may make them.
+     */
+    bool pollCancel() const {
+        if (stopping()) return true;
+        if (!options_.cancel) return false;
+        bool stop;
+        #pragma omp critical(tsp_callbacks)
+        stop = options_.cancel();
+        if (stop) stopRequested_.store(true, std::memory_order_relaxed);
+        return stop;
+    }
+
+    /**
+     * @brief Lets the preempt hook park this thread while more urgent work runs
+     *
+     * Unlike the other callbacks it runs outside the tsp_callbacks critical
+     * section, which is process-wide: a parked thread must not hold it.
+     */
+    void preemptionPoint() const {
+        if (options_.preempt) options_.preempt();
+    }
+
+    /**
+     * @brief Gives this thread's core up until its next preemption point
+     */
+    void releaseCore() const {
+        if (options_.release) options_.release();
+    }
+
+    /**
+     * @brief Counts a finished restart and reports progress
+     * @param length Tour length the restart ended with
+     *
+     * Restarts skipped or cut short after a cancel are not reported.
+     */
+    void restartFinished(double length) {
+        restartsDone_.fetch_add(1, std::memory_order_relaxed);
+        reportProgress(length, true);
+    }
+
+    /**
+     * @brief Records a tour length and calls the progress callback when one is due
+     * @param length Length of a finished restart or of a running descent
+     * @param restartEnded True at the end of a restart
+     *
+     * Without progressInterval only restart ends report. With it, any call may
+     * report once the interval has passed since the last report, so long
+     * descents still show signs of life; the call that finishes the last
+     * restart always reports.
+     */
+    void reportProgress(double length, bool restartEnded) const {
+        if (!options_.progress) return;
+        double best = progressBest_.load(std::memory_order_relaxed);
+        while (length < best && !progressBest_.compare_exchange_weak(best, length)) {}
+        if (stopRequested_.load(std::memory_order_relaxed)) return;
+
+        double interval = options_.progressInterval;
+        bool last = restartEnded &&
+                    restartsDone_.load(std::memory_order_relaxed) == restartsTotal_;
+        auto due = [&](double now) {
+            return interval > 0.0 ? last || now - lastProgress_.load() >= interval
+                                  : restartEnded;
+        };
+        if (!due(omp_get_wtime())) return;
+        #pragma omp critical(tsp_callbacks)
+        {
+            double now = omp_get_wtime();
+            if (due(now)) { // Another thread may have reported meanwhile
+                lastProgress_.store(now);
+                options_.progress(SearchProgress{progressBest_.load(), now - solveStart_,
+                                                 restartsDone_.load(), restartsTotal_});
+            }
+        }
+    }
+
+    /**
+     * @brief Runs the VND chain on a tour until every operator is at a local optimum
+     * @param state Tour to improve in place (city 0 first)
+     * @param numIterations Maximum number of improving moves
+     * @param chain Operators in the order they are tried
+     * @param stats Per-operator counters, parallel to chain
+     */
+    void variableNeighborhoodDescent(TourState& state, int numIterations,
+                                     const std::vector<MoveOperator>& chain,
+                                     std::vector<OperatorStats>& stats) const {
+        if (state.tour.size() < 3) return;
+
+        // VND main loop: each iteration applies one improving move
+        size_t k = 0;
+        for (int iter = 0; iter < numIterations && k < chain.size() && !stopping(); ) {
+            OperatorStats& opStats = stats[k];
+            double start = omp_get_wtime();
+            bool improvement = applyOperator(chain[k], state, opStats);
+            opStats.seconds += omp_get_wtime() - start;
+            ++opStats.calls;
+
+            if (improvement) {
+                ++opStats.improvements;
+                ++iter;
+                k = 0; // Back to the cheapest neighbourhood
+                if (iter % kCancelPollMoves == 0) {
+                    if (preemptionPoint(), pollCancel()) break;
+                    if (options_.progressInterval > 0.0) reportProgress(state.length, false);
+                }
+            } else {
+                ++k;   // Local optimum for this operator, escalate
+            }
+        }
+    }
+
+    /**
+     * @brief Reorders a chain so that the most cost-effective operators run first
+     * @param chain Operator order to sort in place
+     * @param stats Counters parallel to chain, permuted alongside it
+     *
+     * Cost-effectiveness is evaluations per unit of gain, which is deterministic for
+     * a given seed (unlike wall time). Operators that never improved go last.
+     */
+    static void rankChain(std::vector<MoveOperator>& chain, std::vector<OperatorStats>& stats) {
+        std::vector<size_t> order(chain.size());
+        std::iota(order.begin(), order.end(), 0);
+        auto cost = [&stats](size_t k) {
+            return stats[k].gain > 0.0 ? stats[k].evaluations / stats[k].gain
+                                       : std::numeric_limits<double>::max();
+        };
+        std::stable_sort(order.begin(), order.end(),
+                         [&cost](size_t a, size_t b) { return cost(a) < cost(b); });
+
+        std::vector<MoveOperator> sortedChain;
+        std::vector<OperatorStats> sortedStats;
+        for (size_t k : order) {
+            sortedChain.push_back(chain[k]);
+            sortedStats.push_back(stats[k]);
+        }
+        chain = std::move(sortedChain);
+        stats = std::move(sortedStats);
+    }
+};
+
+/**
+ * @brief Priority class of a scheduled job, most urgent first
+ */
+enum class JobPriority {
+    Latency, ///< Small interactive solves: start first, preempt the others
+    Normal,  ///< Default class
+    Batch    ///< Long solves that give their cores up to anything more urgent
+};
+
+/**
+ * @brief Name of a priority class as used in job files
+ */
+inline const char* priorityName(JobPriority priority) {
+    switch (priority) {
+        case JobPriority::Latency: return "latency";
+        case JobPriority::Normal: return "normal";
+        case JobPriority::Batch: return "batch";
+    }
+    return "?";
+}
+
+/**
+ * @brief Parses a priority class name (latency, normal, batch)
+ * @throws std::runtime_error on an unknown name
+ */
+inline JobPriority parsePriorityName(const std::string& name) {
+    if (name == "latency") return JobPriority::Latency;
+    if (name == "normal") return JobPriority::Normal;
+    if (name == "batch") return JobPriority::Batch;
+    throw std::runtime_error("Unknown priority: " + name);
+}
+
+/**
+ * @struct Job
+ * @brief One solve submitted to a JobScheduler
+ */
+struct Job {
+    JobPriority priority = JobPriority::Normal;
+    int cores = 1;             ///< Cores reserved while the job runs (its thread count)
+    int iterations = 1000;     ///< Maximum improving moves per restart
+    int restarts = 10;         ///< Number of restarts
+    unsigned seed = 42;        ///< Base random seed
+    std::vector<int> cities;   ///< Subset to visit (empty: every city)
+    SearchOptions options;     ///< Search settings; engine, threads and hooks are set by the scheduler
+};
+
+/**
+ * @struct JobResult
+ * @brief Tour of a finished job and where its time went
+ */
+struct JobResult {
+    std::vector<int> tour;        ///< Best tour, in instance city indices
+    double length = 0.0;          ///< Its length
+    double queueSeconds = 0.0;    ///< Submission to start
+    double serviceSeconds = 0.0;  ///< Start to finish, time spent preempted included
+    double preemptedSeconds = 0.0; ///< Core-seconds the job's threads spent parked
+};
+
+/**
+ * @class JobScheduler
+ * @brief Runs solves of one instance side by side on a fixed budget of cores
+ *
+ * Every job runs on its own thread with that many OpenMP threads on the
+ * restarts engine, and starts only once that many cores are free: a core is
+ * counted busy from the moment a thread takes it until the thread parks or
+ * runs out of work. Queued jobs start most urgent class first, in submission
+ * order within a class; a job that does not fit blocks everything behind it,
+ * so a stream of small batch jobs cannot starve a large urgent one.
+ *
+ * A job that does not fit asks running jobs of a lower class for the missing
+ * cores. Their threads park at the next preemption point of the search (every
+ * kCancelPollMoves improving moves, and before each restart's descent), each
+ * handing one core over, and resume with their tours intact once cores are
+ * free again and no more urgent job is waiting. Restarts are handed out one at
+ * a time, so the restarts a parked thread has not begun go to its teammates,
+ * and a thread with none left gives its core back instead of holding it at
+ * the closing barrier (where OpenMP spins only briefly before sleeping). A
+ * latency job therefore waits for a few moves of a long batch job, not for the
+ * whole of it.
+ */
+class JobScheduler {
+public:
+    /**
+     * @param instance Problem data shared by every job
+     * @param cores Core budget (0: the OpenMP maximum)
+     */
+    explicit JobScheduler(std::shared_ptr<const Instance> instance, int cores = 0)
+        : instance_(std::move(instance)),
+          cores_(cores > 0 ? cores : omp_get_max_threads()),
+          freeCores_(cores_) {}
+
+    JobScheduler(const JobScheduler&) = delete;
+    JobScheduler& operator=(const JobScheduler&) = delete;
+
+    /**
+     * @brief Waits for every submitted job to finish
+     */
+    ~JobScheduler() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [this] {
+            return std::all_of(jobs_.begin(), jobs_.end(), [](const std::shared_ptr<Entry>& e) {
+                return e->state == State::Done;
+            });
+        });
+        lock.unlock();
+        for (const std::shared_ptr<Entry>& entry : jobs_) entry->worker.join();
+    }
+
+    /**
+     * @brief Queues a job, starting it at once if its cores are free
+     * @return Result, available once the job has finished
+     * @throws std::runtime_error if the job needs more cores than the budget
+     */
+    std::future<JobResult> submit(Job job) {
+        if (job.cores < 1 || job.cores > cores_) {
+            throw std::runtime_error("Job needs 1 to " + std::to_string(cores_) + " cores, not " +
+                                     std::to_string(job.cores));
+        }
+        auto entry = std::make_shared<Entry>();
+        entry->job = std::move(job);
+        entry->submitted = omp_get_wtime();
+        std::future<JobResult> result = entry->promise.get_future();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(entry);
+        dispatch();
+        return result;
+    }
+
+    int cores() const { return cores_; }
+
+private:
+    enum class State { Queued, Running, Done };
+
+    /**
+     * @brief A submitted job and its share of the core budget
+     *
+     * Cores are counted per thread: held is the number of the job's threads
+     * running on a core. All fields but yield are guarded by the scheduler mutex.
+     */
+    struct Entry {
+        Job job;
+        std::promise<JobResult> promise;
+        State state = State::Queued;
+        double submitted = 0.0;
+        double started = 0.0;
+        int held = 0;                ///< Cores in use by running threads
+        int parked = 0;              ///< Threads waiting for a core to continue
+        std::atomic<int> yield{0};   ///< Cores more urgent jobs asked this job to give up
+        double preemptedSeconds = 0.0;
+        std::thread worker;
+    };
+
+    std::shared_ptr<const Instance> instance_;
+    const int cores_;
+    std::mutex mutex_;                          ///< Guards everything below
+    std::condition_variable changed_;           ///< Cores freed, jobs started or finished
+    std::list<std::shared_ptr<Entry>> jobs_;    ///< Every job, in submission order
+    int freeCores_;                             ///< Cores no thread holds
+
+    /**
+     * @brief Starts whatever fits, most urgent class first, and asks for the rest
+     *
+     * Called with the mutex held whenever cores are freed or a job arrives.
+     */
+    void dispatch() {
+        for (JobPriority priority : {JobPriority::Latency, JobPriority::Normal,
+                                     JobPriority::Batch}) {
+            for (const std::shared_ptr<Entry>& entry : jobs_) {
+                if (entry->state != State::Queued || entry->job.priority != priority) continue;
+                // Parked threads of this class or above take freed cores back first
+                int available = freeCores_ - parkedAtOrAbove(priority);
+                if (available >= entry->job.cores) {
+                    start(entry);
+                    continue;
+                }
+                // Yields still outstanding were all asked for this job, the first waiting
+                requestCores(priority, entry->job.cores - available - yieldsOwed());
+                changed_.notify_all();
+                return;
+            }
+        }
+        changed_.notify_all();
+    }
+
+    /**
+     * @brief Parked threads of jobs in this class or a more urgent one
+     */
+    int parkedAtOrAbove(JobPriority priority) const {
+        int parked = 0;
+        for (const std::shared_ptr<Entry>& entry : jobs_) {
+            if (entry->state == State::Running && entry->job.priority <= priority) {
+                parked += entry->parked;
+            }
+        }
+        return parked;
+    }
+
+    /**
+     * @brief Cores running jobs were asked to yield and have not handed over yet
+     */
+    int yieldsOwed() const {
+        int owed = 0;
+        for (const std::shared_ptr<Entry>& entry : jobs_) owed += entry->yield.load();
+        return owed;
+    }
+
+    /**
+     * @brief Asks running jobs below a class to yield cores, least urgent and newest first
+     * @param missing Cores needed beyond the free and already requested ones
+     *
+     * Asks nothing if the jobs below hold too few: the waiting job then starts
+     * once running jobs finish, rather than preempting for a start that would
+     * still not fit.
+     */
+    void requestCores(JobPriority priority, int missing) {
+        if (missing <= 0) return;
+        int promised = 0;
+        std::vector<std::pair<Entry*, int>> asks;
+        for (JobPriority victim : {JobPriority::Batch, JobPriority::Normal}) {
+            if (victim <= priority) break;
+            for (auto it = jobs_.rbegin(); it != jobs_.rend() && promised < missing; ++it) {
+                Entry& entry = **it;
+                if (entry.state != State::Running || entry.job.priority != victim) continue;
+                int give = std::min(missing - promised, entry.held - entry.yield.load());
+                if (give <= 0) continue;
+                asks.emplace_back(&entry, give);
+                promised += give;
+            }
+        }
+        if (promised < missing) return;
+        for (auto [entry, give] : asks) entry->yield += give;
+    }
+
+    /**
+     * @brief True if a queued job of a more urgent class is waiting for cores
+     */
+    bool outranked(JobPriority priority) const {
+        return std::any_of(jobs_.begin(), jobs_.end(), [priority](const std::shared_ptr<Entry>& e) {
+            return e->state == State::Queued && e->job.priority < priority;
+        });
+    }
+
+    /**
+     * @brief Reserves a job's cores and runs it on its own thread
+     */
+    void start(const std::shared_ptr<Entry>& entry) {
+        entry->state = State::Running;
+        entry->started = omp_get_wtime();
+        entry->held = entry->job.cores;
+        freeCores_ -= entry->job.cores;
+        // Outstanding yields were for this job; the next waiting one asks anew
+        for (const std::shared_ptr<Entry>& other : jobs_) other->yield = 0;
+        entry->worker = std::thread(&JobScheduler::run, this, entry);
+    }
+
+    /**
+     * @brief Body of a job's thread: solve, then hand the cores back
+     */
+    void run(std::shared_ptr<Entry> entry) {
+        Job& job = entry->job;
+        JobResult result;
+        std::exception_ptr error;
+        try {
+            SearchOptions options = job.options;
+            options.engine = Engine::ParallelRestarts; // The engine whose threads can yield
+            options.threads = job.cores;
+            Entry* self = entry.get();
+            options.preempt = [this, self]() {
+                if (coreReleased()) {
+                    resume(*self);
+                } else if (self->yield.load(std::memory_order_relaxed) > 0) {
+                    park(*self);
+                }
+            };
+            options.release = [this, self]() { release(*self); };
+            TSPSolver solver(instance_, job.seed);
+            solver.configureSearch(options);
+            result.tour = job.cities.empty()
+                ? solver.solveTSP(job.iterations, job.restarts)
+                : solver.solveSubset(job.cities, job.iterations, job.restarts, false);
+            result.length = solver.calculateTourLength(result.tour);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            double finished = omp_get_wtime();
+            result.queueSeconds = entry->started - entry->submitted;
+            result.serviceSeconds = finished - entry->started;
+            result.preemptedSeconds = entry->preemptedSeconds;
+            freeCores_ += entry->held;
+            entry->held = 0;
+            entry->yield = 0; // Its cores are free now, which covers what it owed
+            entry->state = State::Done;
+            dispatch();
+        }
+        if (error) {
+            entry->promise.set_exception(error);
+        } else {
+            entry->promise.set_value(std::move(result));
+        }
+    }
+
+    /**
+     * @brief Whether the calling thread gave its core up (see release)
+     *
+     * Per thread, since every thread of a job gives up and takes back only its
+     * own core.
+     */
+    static bool& coreReleased() {
+        static thread_local bool released = false;
+        return released;
+    }
+
+    /**
+     * @brief Parks the calling thread of a job that was asked to yield a core
+     *
+     * The thread resumes once nothing more urgent is queued and a core is free,
+     * which with yields still owed means the job it made room for has finished.
+     */
+    void park(Entry& entry) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (entry.yield.load() == 0 || entry.held == 0) return;
+        --entry.yield;
+        --entry.held;
+        ++freeCores_;
+        dispatch();
+        waitForCore(entry, lock);
+    }
+
+    /**
+     * @brief Frees the core of a thread that ran out of work, counting it as a yield
+     */
+    void release(Entry& entry) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (coreReleased() || entry.held == 0) return;
+        coreReleased() = true;
+        if (entry.yield.load() > 0) --entry.yield;
+        --entry.held;
+        ++freeCores_;
+        dispatch();
+    }
+
+    /**
+     * @brief Takes a core back for a thread that released its own and has work again
+     */
+    void resume(Entry& entry) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        coreReleased() = false;
+        waitForCore(entry, lock);
+    }
+
+    /**
+     * @brief Blocks until a core is free and nothing more urgent waits, then takes it
+     */
+    void waitForCore(Entry& entry, std::unique_lock<std::mutex>& lock) {
+        ++entry.parked;
+        double start = omp_get_wtime();
+        changed_.wait(lock, [&] { return freeCores_ > 0 && !outranked(entry.job.priority); });
+        --freeCores_;
+        --entry.parked;
+        ++entry.held;
+        entry.preemptedSeconds += omp_get_wtime() - start;
+    }
+};
+
+#endif // TSP_SOLVER_HPP
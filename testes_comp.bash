@@ -30,6 +30,65 @@ fi
 echo -e "${GREEN}✓ Ambas compilações bem-sucedidas!${NC}"
 echo "=================================="
 
+# Módulo Python (opcional): compila e faz um teste rápido se pybind11 e numpy existirem
+if python3 -c "import pybind11, numpy" 2>/dev/null; then
+    echo -e "${BLUE}Compilando módulo Python (pybind11)...${NC}"
+    python_build=$(mktemp -d)
+    g++ -fopenmp -O3 -std=c++17 -shared -fPIC $(python3 -m pybind11 --includes) \
+        src/tsp_python.cpp -o "$python_build/tsp$(python3-config --extension-suffix)"
+    if [ $? -ne 0 ]; then
+        echo -e "${RED}Erro na compilação do módulo Python!${NC}"
+        exit 1
+    fi
+    PYTHONPATH="$python_build" python3 - <<'PYEOF'
+import numpy as np, tsp
+
+rng = np.random.default_rng(7)
+points = rng.random((60, 2)) * 1000
+matrix = np.sqrt(((points[:, None, :] - points[None, :, :]) ** 2).sum(axis=2))
+
+def check(tour, length, cities):
+    assert sorted(tour.tolist()) == sorted(cities), "tour is not a permutation"
+    closed = np.append(tour, tour[0])
+    assert abs(matrix[closed[:-1], closed[1:]].sum() - length) < 1e-6 * length
+
+for dtype in (np.float64, np.float32, np.int32):
+    instance = tsp.Instance(matrix.astype(dtype))
+    assert len(instance) == 60
+    tour, length = tsp.solve(instance, iterations=200, restarts=4, seed=1)
+    assert tour[0] == 0
+    if dtype == np.float64:
+        check(tour, length, list(range(60)))
+
+instance = tsp.Instance(matrix)
+subset = list(range(0, 60, 3))
+tour, length = tsp.solve(instance, iterations=200, restarts=2, cities=subset)
+check(tour, length, subset)
+tour, length = tsp.solve(instance, iterations=10**6, restarts=64, cancel=lambda: True)
+check(tour, length, list(range(60)))
+for bad in (np.zeros((3, 4)), np.zeros((4, 4), dtype=np.int8)):
+    try:
+        tsp.Instance(bad)
+        raise AssertionError("invalid matrix accepted")
+    except ValueError:
+        pass
+try:
+    tsp.solve(instance, vnd=",")
+    raise AssertionError("empty operator chain accepted")
+except ValueError:
+    pass
+PYEOF
+    if [ $? -ne 0 ]; then
+        echo -e "${RED}Teste do módulo Python falhou!${NC}"
+        exit 1
+    fi
+    rm -rf "$python_build"
+    echo -e "${GREEN}✓ Módulo Python compilado e testado!${NC}"
+else
+    echo -e "${YELLOW}pybind11/numpy não encontrados: módulo Python não testado${NC}"
+fi
+echo "=================================="
+
 # Configurar número de threads para OpenMP
 export OMP_NUM_THREADS=8
 